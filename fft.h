@@ -0,0 +1,410 @@
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "grid.h"
+
+namespace grid_h {
+
+typedef std::complex<double> cplx;
+
+// A plan for one dimensional complex FFTs of a fixed size, using a mixed
+// radix decimation in time algorithm with radix 2 and 4 butterflies and a
+// generic butterfly for other factors.  A plan owns its twiddle factors
+// and work buffers; cached() keeps one plan per size and direction for
+// each thread, so repeated transforms neither re-plan nor allocate.
+// Inverse transforms are not scaled.
+
+class fft_plan {
+ private:
+  size_t n;  // transform size
+  bool inverse;
+  std::vector<size_t> factors;  // pairs of (radix, remaining length)
+  std::vector<cplx> twiddles;  // exp(-+2 pi i k / n)
+  std::vector<cplx> buf;  // out of place output
+  std::vector<cplx> scratch;  // generic butterfly inputs
+
+  static cplx mul(const cplx& a, const cplx& b) {
+    return cplx(a.real() * b.real() - a.imag() * b.imag(),
+        a.real() * b.imag() + a.imag() * b.real());
+  }
+  void work(cplx* out, const cplx* in, size_t fstride, size_t in_stride,
+      const size_t* f);
+  void butterfly2(cplx* out, size_t fstride, size_t m) const;
+  void butterfly4(cplx* out, size_t fstride, size_t m) const;
+  void butterfly(cplx* out, size_t fstride, size_t m, size_t p);
+
+ public:
+  fft_plan(size_t size, bool inv);
+  fft_plan(const fft_plan&) = delete;
+  fft_plan& operator=(const fft_plan&) = delete;
+
+  size_t size() const { return n; }
+  void execute(cplx* data, size_t stride = 1);
+
+  static fft_plan& cached(size_t size, bool inv);
+  static size_t cache_size() { return cache().size(); }
+  static void clear_cache() { cache().clear(); }
+
+ private:
+  static std::map<std::pair<size_t, bool>, std::unique_ptr<fft_plan>>&
+  cache() {
+    thread_local std::map<std::pair<size_t, bool>, std::unique_ptr<fft_plan>>
+        plans;
+    return plans;
+  }
+};  // class fft_plan
+
+// __________________________________________________________________________
+// Factor the size, preferring radix 4, and compute the twiddle factors.
+
+inline fft_plan::fft_plan(size_t size, bool inv)
+    : n(size), inverse(inv), twiddles(size), buf(size) {
+  const double phase = (inverse ? 2 : -2) * std::acos(-1.0);
+  for (size_t k = 0; k < n; ++k) {
+    twiddles[k] = std::polar(1.0, phase * k / n);
+  }
+  size_t m = n, p = 4, maxp = 0;
+  while (m > 1) {
+    while (m % p) {
+      p = p == 4 ? 2 : (p == 2 ? 3 : p + 2);
+      if (p * p > m) {
+        p = m;
+      }
+    }
+    m /= p;
+    factors.push_back(p);
+    factors.push_back(m);
+    maxp = std::max(maxp, p);
+  }
+  scratch.resize(maxp);
+}
+
+// __________________________________________________________________________
+// Return this thread's plan for a size and direction, creating it once.
+
+inline fft_plan& fft_plan::cached(size_t size, bool inv) {
+  std::unique_ptr<fft_plan>& plan = cache()[std::make_pair(size, inv)];
+  if (!plan) {
+    plan.reset(new fft_plan(size, inv));
+  }
+  return *plan;
+}
+
+// __________________________________________________________________________
+// Transform 'n' values spaced 'stride' apart in place.
+
+inline void fft_plan::execute(cplx* data, size_t stride) {
+  if (n <= 1) {
+    return;
+  }
+  work(buf.data(), data, 1, stride, factors.data());
+  for (size_t k = 0; k < n; ++k) {
+    data[k * stride] = buf[k];
+  }
+}
+
+// __________________________________________________________________________
+// Recursively transform the p interleaved subsequences of length m, then
+// combine them with radix p butterflies.
+
+inline void fft_plan::work(cplx* out, const cplx* in, size_t fstride,
+    size_t in_stride, const size_t* f) {
+  const size_t p = f[0], m = f[1];
+  const size_t step = fstride * in_stride;
+  if (m == 1) {
+    for (size_t k = 0; k < p; ++k) {
+      out[k] = in[k * step];
+    }
+  } else {
+    for (size_t k = 0; k < p; ++k) {
+      work(out + k * m, in + k * step, fstride * p, in_stride, f + 2);
+    }
+  }
+  switch (p) {
+    case 2:
+      butterfly2(out, fstride, m);
+      break;
+    case 4:
+      butterfly4(out, fstride, m);
+      break;
+    default:
+      butterfly(out, fstride, m, p);
+      break;
+  }
+}
+
+// __________________________________________________________________________
+
+inline void fft_plan::butterfly2(cplx* out, size_t fstride, size_t m) const {
+  cplx* out2 = out + m;
+  for (size_t k = 0; k < m; ++k) {
+    const cplx t = mul(out2[k], twiddles[k * fstride]);
+    out2[k] = out[k] - t;
+    out[k] += t;
+  }
+}
+
+// __________________________________________________________________________
+
+inline void fft_plan::butterfly4(cplx* out, size_t fstride, size_t m) const {
+  const cplx j = inverse ? cplx(0, 1) : cplx(0, -1);
+  for (size_t k = 0; k < m; ++k) {
+    const cplx s0 = mul(out[k + m], twiddles[k * fstride]);
+    const cplx s1 = mul(out[k + 2 * m], twiddles[2 * k * fstride]);
+    const cplx s2 = mul(out[k + 3 * m], twiddles[3 * k * fstride]);
+    const cplx s3 = s0 + s2;
+    const cplx s4 = mul(s0 - s2, j);
+    const cplx s5 = out[k] - s1;
+    const cplx s6 = out[k] + s1;
+    out[k] = s6 + s3;
+    out[k + m] = s5 + s4;
+    out[k + 2 * m] = s6 - s3;
+    out[k + 3 * m] = s5 - s4;
+  }
+}
+
+// __________________________________________________________________________
+// A direct radix p butterfly, for factors other than 2 and 4.
+
+inline void fft_plan::butterfly(
+    cplx* out, size_t fstride, size_t m, size_t p) {
+  for (size_t u = 0; u < m; ++u) {
+    for (size_t q = 0, k = u; q < p; ++q, k += m) {
+      scratch[q] = out[k];
+    }
+    for (size_t q = 0, k = u; q < p; ++q, k += m) {
+      size_t tw = 0;
+      out[k] = scratch[0];
+      for (size_t r = 1; r < p; ++r) {
+        tw += fstride * k;
+        if (tw >= n) {
+          tw -= n;
+        }
+        out[k] += mul(scratch[r], twiddles[tw]);
+      }
+    }
+  }
+}
+
+// __________________________________________________________________________
+// The smallest size >= 'n' whose only prime factors are 2, 3 and 5.
+
+inline size_t fft_good_size(size_t n) {
+  for (;; ++n) {
+    size_t m = n;
+    for (size_t p : {2, 3, 5}) {
+      while (m > 1 && m % p == 0) {
+        m /= p;
+      }
+    }
+    if (m <= 1) {
+      return n;
+    }
+  }
+}
+
+// __________________________________________________________________________
+// The 2-D FFT of 'm', zero padded to 'rows' x 'cols'.  Since 'm' is real
+// only the first rows / 2 + 1 rows of the spectrum are returned.  Columns
+// are transformed two at a time as the real and imaginary parts of one
+// complex column; then each remaining row is transformed.
+
+template <class T>
+grid<cplx> rfft2(const grid<T>& m, size_t rows, size_t cols) {
+  assert(rows >= m.rows() && cols >= m.cols());
+  const size_t h = rows / 2 + 1;
+  grid<cplx> f(h, cols);
+  f.clear();
+  if (rows == 0 || cols == 0) {
+    return f;
+  }
+  fft_plan& colplan = fft_plan::cached(rows, false);
+  std::vector<cplx> z(rows);
+  for (size_t j = 0; j < m.cols(); j += 2) {
+    const bool pair = j + 1 < m.cols();
+    std::fill(z.begin(), z.end(), cplx(0));
+    for (size_t i = 0; i < m.rows(); ++i) {
+      z[i] = cplx(m(i, j), pair ? m(i, j + 1) : 0);
+    }
+    colplan.execute(z.data());
+    for (size_t k = 0; k < h; ++k) {
+      const cplx a = z[k];
+      const cplx b = std::conj(z[(rows - k) % rows]);
+      f(k, j) = 0.5 * (a + b);
+      if (pair) {
+        f(k, j + 1) = cplx(0, -0.5) * (a - b);
+      }
+    }
+  }
+  fft_plan& rowplan = fft_plan::cached(cols, false);
+  for (size_t k = 0; k < h; ++k) {
+    rowplan.execute(&f(k, 0), h);
+  }
+  return f;
+}
+
+template <class T>
+grid<cplx> rfft2(const grid<T>& m) {
+  return rfft2(m, m.rows(), m.cols());
+}
+
+// __________________________________________________________________________
+// The inverse of rfft2 for a 'rows' x f.cols() real grid, scaled so that
+// irfft2(rfft2(m), m.rows()) == m.
+
+inline grid<double> irfft2(const grid<cplx>& f, size_t rows) {
+  const size_t h = rows / 2 + 1;
+  const size_t cols = f.cols();
+  assert(f.rows() == h);
+  grid<double> m(rows, cols);
+  if (rows == 0 || cols == 0) {
+    return m;
+  }
+  grid<cplx> g = f;
+  fft_plan& rowplan = fft_plan::cached(cols, true);
+  for (size_t k = 0; k < h; ++k) {
+    rowplan.execute(&g(k, 0), h);
+  }
+  fft_plan& colplan = fft_plan::cached(rows, true);
+  const double scale = 1.0 / (rows * cols);
+  std::vector<cplx> z(rows);
+  for (size_t j = 0; j < cols; j += 2) {
+    const bool pair = j + 1 < cols;
+    for (size_t k = 0; k < rows; ++k) {
+      const bool lower = k < h;
+      const cplx a = lower ? g(k, j) : std::conj(g(rows - k, j));
+      const cplx b = !pair ? cplx(0) :
+          (lower ? g(k, j + 1) : std::conj(g(rows - k, j + 1)));
+      z[k] = a + cplx(0, 1) * b;
+    }
+    colplan.execute(z.data());
+    for (size_t i = 0; i < rows; ++i) {
+      m(i, j) = z[i].real() * scale;
+      if (pair) {
+        m(i, j + 1) = z[i].imag() * scale;
+      }
+    }
+  }
+  return m;
+}
+
+// __________________________________________________________________________
+// Which part of a convolution to return: all of it, the central part with
+// the size of the first grid, or only the part computed without padding.
+
+enum class conv_mode { full, same, valid };
+
+// __________________________________________________________________________
+// Convolve 'm' with the kernel 'k' using FFTs of a size with small prime
+// factors.
+
+template <class T>
+grid<double> fft_convolve(const grid<T>& m, const grid<T>& k,
+    conv_mode mode = conv_mode::full) {
+  const size_t fr = m.rows() + k.rows() - 1;
+  const size_t fc = m.cols() + k.cols() - 1;
+  if (m.rows() == 0 || m.cols() == 0 || k.rows() == 0 || k.cols() == 0) {
+    return grid<double>();
+  }
+  const size_t rows = fft_good_size(fr);
+  const size_t cols = fft_good_size(fc);
+  grid<cplx> fm = rfft2(m, rows, cols);
+  const grid<cplx> fk = rfft2(k, rows, cols);
+  for (size_t i = 0; i < fm.storage().size(); ++i) {
+    fm[i] *= fk[i];
+  }
+  const grid<double> full = irfft2(fm, rows);
+
+  size_t r0 = 0, c0 = 0, nr = fr, nc = fc;
+  if (mode == conv_mode::same) {
+    r0 = (k.rows() - 1) / 2;
+    c0 = (k.cols() - 1) / 2;
+    nr = m.rows();
+    nc = m.cols();
+  } else if (mode == conv_mode::valid) {
+    assert(m.rows() >= k.rows() && m.cols() >= k.cols());
+    r0 = k.rows() - 1;
+    c0 = k.cols() - 1;
+    nr = m.rows() - k.rows() + 1;
+    nc = m.cols() - k.cols() + 1;
+  }
+  grid<double> tmp;
+  full.subgrid(&tmp, r0, c0, nr, nc);
+  return tmp;
+}
+
+// __________________________________________________________________________
+// Cross-correlate 'm' with the template 't' at every position where 't'
+// fits inside 'm': c(i, j) = sum over (u, v) of m(i + u, j + v) * t(u, v).
+
+template <class T>
+grid<double> correlate(const grid<T>& m, const grid<T>& t) {
+  grid<T> flipped(t.rows(), t.cols());
+  for (size_t j = 0; j < t.cols(); ++j)
+    for (size_t i = 0; i < t.rows(); ++i)
+      flipped(t.rows() - 1 - i, t.cols() - 1 - j) = t(i, j);
+  return fft_convolve(m, flipped, conv_mode::valid);
+}
+
+// __________________________________________________________________________
+// Normalized cross-correlation of 'm' with the template 't' at every
+// position where 't' fits inside 'm', in [-1, 1].  The window sums in the
+// denominator come from integral images.  Windows or templates with no
+// variation give 0.
+
+template <class T>
+grid<double> normalized_correlate(const grid<T>& m, const grid<T>& t) {
+  assert(m.rows() >= t.rows() && m.cols() >= t.cols());
+  const size_t tr = t.rows(), tc = t.cols();
+  const double n = tr * tc;
+
+  // Correlating with the zero mean template makes the numerator
+  // independent of the window mean.
+  grid<double> t0 = grid_cast<double>(t, rounding::truncate, false, 1,
+      -t.mean());
+  const double tnorm = t0.norm();
+  grid<double> c = correlate(grid_cast<double>(m), t0);
+
+  // Integral images of m and m^2, shifted by the mean of m for accuracy.
+  const double shift = m.mean();
+  grid<double> s1(m.rows() + 1, m.cols() + 1), s2(m.rows() + 1, m.cols() + 1);
+  s1.clear();
+  s2.clear();
+  for (size_t j = 0; j < m.cols(); ++j) {
+    for (size_t i = 0; i < m.rows(); ++i) {
+      const double v = m(i, j) - shift;
+      s1(i + 1, j + 1) = v + s1(i, j + 1) + s1(i + 1, j) - s1(i, j);
+      s2(i + 1, j + 1) = v * v + s2(i, j + 1) + s2(i + 1, j) - s2(i, j);
+    }
+  }
+
+  for (size_t j = 0; j < c.cols(); ++j) {
+    for (size_t i = 0; i < c.rows(); ++i) {
+      const double sum = s1(i + tr, j + tc) - s1(i, j + tc) -
+          s1(i + tr, j) + s1(i, j);
+      const double sumsq = s2(i + tr, j + tc) - s2(i, j + tc) -
+          s2(i + tr, j) + s2(i, j);
+      const double var = sumsq - sum * sum / n;
+      if (tnorm == 0 || var <= 1e-12 * sumsq) {
+        c(i, j) = 0;
+      } else {
+        c(i, j) = std::max(-1.0, std::min(1.0, c(i, j) / (std::sqrt(var) *
+            tnorm)));
+      }
+    }
+  }
+  return c;
+}
+
+};  // namespace grid_h
+
+#endif  // FFT_H_
@@ -8,15 +8,147 @@
 #include <cassert>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <numeric>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "instrument.h"
 #include "utils.h"
 
 namespace grid_h {
 
+// Element types which can be sorted by radix, and the unsigned type whose
+// ordering matches theirs.
+
+template <class T, class Enable = void>
+struct radix_traits { static const bool sortable = false; };
+
+template <class T>
+struct radix_traits<T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  static const bool sortable = true;
+  typedef typename std::make_unsigned<T>::type key_type;
+};
+
+template <>
+struct radix_traits<float> {
+  static const bool sortable = true;
+  typedef uint32_t key_type;
+};
+
+template <>
+struct radix_traits<double> {
+  static const bool sortable = true;
+  typedef uint64_t key_type;
+};
+
+// __________________________________________________________________________
+// Map a value to an unsigned key with the same (or, if 'descending', the
+// reverse) ordering.
+
+template <class T>
+typename radix_traits<T>::key_type radix_key(T val, bool descending) {
+  typedef typename radix_traits<T>::key_type U;
+  const U high = U(1) << (8 * sizeof(U) - 1);
+  U key;
+  if constexpr (std::is_floating_point<T>::value) {
+    memcpy(&key, &val, sizeof(key));
+    key = (key & high) ? static_cast<U>(~key) : (key | high);
+  } else if constexpr (std::is_signed<T>::value) {
+    key = static_cast<U>(val) ^ high;
+  } else {
+    key = val;
+  }
+  return descending ? static_cast<U>(~key) : key;
+}
+
+// The type in which the elements of a grid<T> are summed: small integer
+// types are widened so that sums do not overflow, and float is summed as
+// double.
+
+template <class T, class Enable = void>
+struct sum_traits { typedef T type; };
+
+template <class T>
+struct sum_traits<T, typename std::enable_if<
+    std::is_integral<T>::value && std::is_signed<T>::value>::type> {
+  typedef int64_t type;
+};
+
+template <class T>
+struct sum_traits<T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_signed<T>::value>::type> {
+  typedef uint64_t type;
+};
+
+template <>
+struct sum_traits<float> { typedef double type; };
+
+// A running sum.  Floating point sums use Kahan compensation, which must
+// not be compiled with -ffast-math.
+
+template <class S>
+class sum_accumulator {
+ private:
+  S sum, c;  // running sum, and compensation for lost low order bits
+
+ public:
+  sum_accumulator() : sum(0), c(0) { }
+  void add(S x) {
+    if constexpr (std::is_floating_point<S>::value) {
+      const S y = x - c;
+      const S t = sum + y;
+      c = (t - sum) - y;
+      sum = t;
+    } else {
+      sum += x;
+    }
+  }
+  void add(const sum_accumulator& m) { add(m.sum); add(-m.c); }
+  S value() const { return sum - c; }
+};
+
+// A running count, mean and sum of squared deviations from the mean,
+// updated with Welford's method and merged with Chan's.
+
+class moment_accumulator {
+ private:
+  double n, mean, m2;
+
+ public:
+  moment_accumulator() : n(0), mean(0), m2(0) { }
+  void add(double x) {
+    n += 1;
+    const double delta = x - mean;
+    mean += delta / n;
+    m2 += delta * (x - mean);
+  }
+  void add(const moment_accumulator& m) {
+    if (m.n == 0)
+      return;
+    const double total = n + m.n;
+    const double delta = m.mean - mean;
+    mean += delta * m.n / total;
+    m2 += m.m2 + delta * delta * n * m.n / total;
+    n = total;
+  }
+  double variance() const { return m2 / n; }
+};
+
+// The direction of a reduction.  Reducing along columns gives one value
+// per column (a 1 x cols() grid); reducing along rows gives one value per
+// row (a rows() x 1 grid).
+
+enum class along { columns, rows };
+
+// How grid_cast() and convert_into() round values converted to an integer
+// type.  Nearest rounds halves to even.
+
+enum class rounding { truncate, nearest, floor, ceil };
+
 template <class T>
 class grid {
  private:
@@ -27,6 +159,33 @@ class grid {
   int consistent() const { return sto.size() == nr * nc; }
   int inrange(size_t r, size_t c) const { return r < nr && c < nc; }
 
+  // Sorting Helpers
+  void radix_sort(std::vector<size_t>* permutation, size_t col,
+      bool descending, size_t nthreads) const;
+  void merge_sort(std::vector<size_t>* permutation,
+      const std::vector<size_t>& keys, bool descending, size_t nthreads) const;
+
+  // Reduction Helpers
+  template <class A, class Add, class Merge>
+  static A reduce_range(const T* p, size_t n, const A& init, Add add,
+      Merge merge);
+  template <class A, class Add, class Merge>
+  A reduce(size_t nthreads, const A& init, Add add, Merge merge) const;
+  template <class A, class Add, class Merge>
+  std::vector<A> reduce(along a, size_t nthreads, const A& init, Add add,
+      Merge merge) const;
+  template <class R, class A, class F>
+  grid<R> reduced(along a, const std::vector<A>& acc, F f) const;
+  static std::pair<T, T> minmax_init();
+  template <class Less>
+  static bool better(const T& x, const T& best, Less less) {
+    return less(x, best) || (best != best && x == x);  // NaN 'best'
+  }
+  template <class Less>
+  size_t argbest(size_t nthreads, Less less) const;
+  template <class Less>
+  grid<size_t> argbest(along a, Less less) const;
+
  public:
   // Constructors, Operator=
   grid() : nr(0), nc(0) { }
@@ -118,7 +277,30 @@ class grid {
     return c;
   }
   int onpixels() const { return(nr * nc - offpixels()); }
-  void sort(size_t col);
+
+  // Reductions, over the whole grid or along rows or columns, using up to
+  // 'nthreads' threads (0 means one per core).
+  typedef typename sum_traits<T>::type sum_type;
+  sum_type sum(size_t nthreads = 1) const;
+  grid<sum_type> sum(along a, size_t nthreads = 1) const;
+  double mean(size_t nthreads = 1) const;
+  grid<double> mean(along a, size_t nthreads = 1) const;
+  double variance(size_t nthreads = 1) const;
+  grid<double> variance(along a, size_t nthreads = 1) const;
+  double norm(size_t nthreads = 1) const;
+  grid<double> norm(along a, size_t nthreads = 1) const;
+  std::pair<T, T> minmax(size_t nthreads = 1) const;
+  std::pair<grid<T>, grid<T>> minmax(along a, size_t nthreads = 1) const;
+  size_t argmin(size_t nthreads = 1) const;
+  size_t argmax(size_t nthreads = 1) const;
+  grid<size_t> argmin(along a) const;
+  grid<size_t> argmax(along a) const;
+  void sort(size_t col) { sort_by({col}); }
+  void sort_by(const std::vector<size_t>& keys, bool descending = false,
+      size_t nthreads = 1);
+  std::vector<size_t> argsort(const std::vector<size_t>& keys,
+      bool descending = false, size_t nthreads = 1) const;
+  void permute(const std::vector<size_t>& permutation, size_t nthreads = 1);
 };  // class grid
 
 // __________________________________________________________________________
@@ -156,6 +338,7 @@ void grid<T>::dump(size_t max, bool invert) const {
 
 template<class T>
 void grid<T>::write(const char *file) {
+  GRID_INSTRUMENT_OP(write);
   assert(consistent());
   Ofstream(ofs, file);
   if (!ofs) {
@@ -168,6 +351,7 @@ void grid<T>::write(const char *file) {
   varwrite(ofs, nr);
   varwrite(ofs, nc);
   arraywrite(ofs, sto, nr * nc);
+  GRID_INSTRUMENT_COUNT(nr * nc, 0, nr * nc * sizeof(T));
 }
 
 // __________________________________________________________________________
@@ -175,6 +359,7 @@ void grid<T>::write(const char *file) {
 
 template<class T>
 int grid<T>::write(std::ofstream& ofs) {
+  GRID_INSTRUMENT_OP(write);
   assert(consistent());
 
   // if (!ofs.is_open())
@@ -184,6 +369,7 @@ int grid<T>::write(std::ofstream& ofs) {
   varwrite(ofs, nr);
   varwrite(ofs, nc);
   arraywrite(ofs, sto, nr * nc);
+  GRID_INSTRUMENT_COUNT(nr * nc, 0, nr * nc * sizeof(T));
 
   return 1;
 }
@@ -201,6 +387,7 @@ size_t grid<T>::size() const {
 
 template<class T>
 int grid<T>::read(const char *file) {
+  GRID_INSTRUMENT_OP(read);
   assert(consistent());
   Ifstream(ifs, file);
   if (!ifs)
@@ -210,6 +397,7 @@ int grid<T>::read(const char *file) {
   ifs.read(version, 4);
   if (memcmp(version, "GR11", 4) != 0 && memcmp(version, "GR12", 4) != 0) {
     if (loadpgm(file)) {
+      GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
       return 1;
     } else {
       std::cerr << "The file [" << file << "] is not a grid or pgm file"
@@ -239,6 +427,7 @@ int grid<T>::read(const char *file) {
     }
   }
   assert(consistent());
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
 
   return 1;
 }
@@ -248,6 +437,7 @@ int grid<T>::read(const char *file) {
 
 template<class T>
 int grid<T>::read(std::ifstream& is) {
+  GRID_INSTRUMENT_OP(read);
   assert(consistent());
 
   // if (!is.is_open() || is.eof())
@@ -262,6 +452,7 @@ int grid<T>::read(std::ifstream& is) {
     arrayread(is, sto, nr * nc);
   }
   assert(consistent());
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
   return 1;
 }
 
@@ -287,6 +478,9 @@ void grid<T>::subgrid(
   assert(r + numrows <= nr && c + numcols <= nc);
 
   if (this != m) {
+    GRID_INSTRUMENT_OP(subgrid);
+    GRID_INSTRUMENT_COUNT(numrows * numcols, numrows * numcols * sizeof(T),
+        numrows * numcols * sizeof(T));
     m->resize(numrows, numcols);
     if (nr > 0 && nc > 0) {
       for (size_t i = 0; i < m->nr; ++i) {
@@ -361,8 +555,7 @@ grid<T> grid<T>::operator+(T val) const {
 template<class T>
 grid<T>& grid<T>::scale(T val) {
   if (nr > 0 && nc > 0) {
-    const T gmin = *std::min_element(begin(), end());
-    const T gmax = *std::max_element(begin(), end());
+    const auto [gmin, gmax] = minmax();
     const T absmax = std::max(std::abs(gmin), std::abs(gmax));
     if (absmax != 0) {
       for (auto& el : *this) { el = el * val / absmax; }
@@ -379,8 +572,7 @@ template<class T>
 grid<T>& grid<T>::transform(T val1, T val2) {
   if (nr == 0 || nc == 0)
     return *this;
-  const T gmin = *std::min_element(begin(), end());
-  const T gmax = *std::max_element(begin(), end());
+  const auto [gmin, gmax] = minmax();
   const T oldrange = gmax - gmin;
   const T newrange = val2 - val1;
   if (oldrange != 0) {
@@ -395,11 +587,303 @@ grid<T>& grid<T>::transform(T val1, T val2) {
   return *this;
 }
 
+// __________________________________________________________________________
+// Reduce 'n' contiguous elements with four independent accumulators, so
+// that consecutive additions do not wait on each other and can be
+// vectorized.
+
+template<class T>
+template <class A, class Add, class Merge>
+A grid<T>::reduce_range(const T* p, size_t n, const A& init, Add add,
+    Merge merge) {
+  A lane[4] = {init, init, init, init};
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    add(lane[0], p[i]);
+    add(lane[1], p[i + 1]);
+    add(lane[2], p[i + 2]);
+    add(lane[3], p[i + 3]);
+  }
+  for (; i < n; ++i) {
+    add(lane[0], p[i]);
+  }
+  merge(lane[0], lane[1]);
+  merge(lane[2], lane[3]);
+  merge(lane[0], lane[2]);
+  return lane[0];
+}
+
+// __________________________________________________________________________
+// Reduce the whole grid, splitting large grids into one chunk per thread.
+
+template<class T>
+template <class A, class Add, class Merge>
+A grid<T>::reduce(size_t nthreads, const A& init, Add add, Merge merge) const {
+  const size_t n = nr * nc;
+  const size_t nt = std::min(utils_h::num_threads(nthreads),
+      std::max<size_t>(1, n / 32768));
+  std::vector<A> partial(nt, init);
+  utils_h::parallel_for(nt, nt, [&](size_t t0, size_t t1) {
+    for (size_t t = t0; t < t1; ++t) {
+      const size_t first = n * t / nt;
+      partial[t] = reduce_range(
+          sto.data() + first, n * (t + 1) / nt - first, init, add, merge);
+    }
+  });
+  for (size_t t = 1; t < nt; ++t) {
+    merge(partial[0], partial[t]);
+  }
+  return partial[0];
+}
+
+// __________________________________________________________________________
+// Reduce each column or each row.  Rows are reduced a column at a time
+// into one accumulator per row, so that memory is read sequentially.
+
+template<class T>
+template <class A, class Add, class Merge>
+std::vector<A> grid<T>::reduce(along a, size_t nthreads, const A& init,
+    Add add, Merge merge) const {
+  if (a == along::columns) {
+    std::vector<A> acc(nc, init);
+    utils_h::parallel_for(nc, nthreads, [&](size_t c0, size_t c1) {
+      for (size_t j = c0; j < c1; ++j) {
+        acc[j] = reduce_range(sto.data() + j * nr, nr, init, add, merge);
+      }
+    });
+    return acc;
+  }
+  std::vector<A> acc(nr, init);
+  utils_h::parallel_for(nr, nthreads, [&](size_t r0, size_t r1) {
+    for (size_t j = 0; j < nc; ++j) {
+      const T* col = sto.data() + j * nr;
+      for (size_t i = r0; i < r1; ++i) {
+        add(acc[i], col[i]);
+      }
+    }
+  });
+  return acc;
+}
+
+// __________________________________________________________________________
+// Shape the accumulators of a reduction along rows or columns as a grid.
+
+template<class T>
+template <class R, class A, class F>
+grid<R> grid<T>::reduced(along a, const std::vector<A>& acc, F f) const {
+  grid<R> tmp = a == along::columns ? grid<R>(1, nc) : grid<R>(nr, 1);
+  std::transform(acc.begin(), acc.end(), tmp.begin(), f);
+  return tmp;
+}
+
+// __________________________________________________________________________
+// Sums.  Floating point values are summed with Kahan compensation.
+
+template<class T>
+typename grid<T>::sum_type grid<T>::sum(size_t nthreads) const {
+  typedef sum_accumulator<sum_type> A;
+  return reduce(nthreads, A(),
+      [](A& acc, const T& el) { acc.add(el); },
+      [](A& acc, const A& m) { acc.add(m); }).value();
+}
+
+template<class T>
+grid<typename grid<T>::sum_type> grid<T>::sum(
+    along a, size_t nthreads) const {
+  typedef sum_accumulator<sum_type> A;
+  return reduced<sum_type>(a, reduce(a, nthreads, A(),
+      [](A& acc, const T& el) { acc.add(el); },
+      [](A& acc, const A& m) { acc.add(m); }),
+      [](const A& acc) { return acc.value(); });
+}
+
+// __________________________________________________________________________
+// Means.
+
+template<class T>
+double grid<T>::mean(size_t nthreads) const {
+  return static_cast<double>(sum(nthreads)) / (nr * nc);
+}
+
+template<class T>
+grid<double> grid<T>::mean(along a, size_t nthreads) const {
+  const double n = a == along::columns ? nr : nc;
+  grid<sum_type> sums = sum(a, nthreads);
+  return reduced<double>(a, sums.storage(),
+      [n](const sum_type& el) { return el / n; });
+}
+
+// __________________________________________________________________________
+// Population variances, accumulated in a single numerically stable pass.
+
+template<class T>
+double grid<T>::variance(size_t nthreads) const {
+  typedef moment_accumulator A;
+  return reduce(nthreads, A(),
+      [](A& acc, const T& el) { acc.add(el); },
+      [](A& acc, const A& m) { acc.add(m); }).variance();
+}
+
+template<class T>
+grid<double> grid<T>::variance(along a, size_t nthreads) const {
+  typedef moment_accumulator A;
+  return reduced<double>(a, reduce(a, nthreads, A(),
+      [](A& acc, const T& el) { acc.add(el); },
+      [](A& acc, const A& m) { acc.add(m); }),
+      [](const A& acc) { return acc.variance(); });
+}
+
+// __________________________________________________________________________
+// Euclidean norms.
+
+template<class T>
+double grid<T>::norm(size_t nthreads) const {
+  typedef sum_accumulator<double> A;
+  return std::sqrt(reduce(nthreads, A(),
+      [](A& acc, const T& el) { acc.add(static_cast<double>(el) * el); },
+      [](A& acc, const A& m) { acc.add(m); }).value());
+}
+
+template<class T>
+grid<double> grid<T>::norm(along a, size_t nthreads) const {
+  typedef sum_accumulator<double> A;
+  return reduced<double>(a, reduce(a, nthreads, A(),
+      [](A& acc, const T& el) { acc.add(static_cast<double>(el) * el); },
+      [](A& acc, const A& m) { acc.add(m); }),
+      [](const A& acc) { return std::sqrt(acc.value()); });
+}
+
+// __________________________________________________________________________
+// Smallest and largest values.  The grid, or each row or column, must be
+// nonempty.  NaN values are ignored; if every value is NaN the result is
+// (infinity, -infinity).
+
+template<class T>
+std::pair<T, T> grid<T>::minmax_init() {
+  typedef std::numeric_limits<T> lim;
+  return lim::has_infinity ? std::make_pair(lim::infinity(), -lim::infinity())
+      : std::make_pair(lim::max(), lim::lowest());
+}
+
+template<class T>
+std::pair<T, T> grid<T>::minmax(size_t nthreads) const {
+  typedef std::pair<T, T> A;
+  assert(nr > 0 && nc > 0);
+  auto merge = [](A& acc, const A& m) {
+    acc.first = std::min(acc.first, m.first);
+    acc.second = std::max(acc.second, m.second);
+  };
+  return reduce(nthreads, minmax_init(),
+      [](A& acc, const T& el) {
+        acc.first = std::min(acc.first, el);
+        acc.second = std::max(acc.second, el);
+      }, merge);
+}
+
+template<class T>
+std::pair<grid<T>, grid<T>> grid<T>::minmax(along a, size_t nthreads) const {
+  typedef std::pair<T, T> A;
+  assert(a == along::columns ? nr > 0 : nc > 0);
+  auto merge = [](A& acc, const A& m) {
+    acc.first = std::min(acc.first, m.first);
+    acc.second = std::max(acc.second, m.second);
+  };
+  const std::vector<A> acc = reduce(a, nthreads, minmax_init(),
+      [](A& acc, const T& el) {
+        acc.first = std::min(acc.first, el);
+        acc.second = std::max(acc.second, el);
+      }, merge);
+  return std::make_pair(
+      reduced<T>(a, acc, [](const A& m) { return m.first; }),
+      reduced<T>(a, acc, [](const A& m) { return m.second; }));
+}
+
+// __________________________________________________________________________
+// Positions of the first smallest and largest values, found in one pass.
+// For the whole grid this is an index into storage(); along columns it is
+// a row and along rows it is a column.  As for minmax(), NaN values are
+// ignored, unless every value is NaN, when the first position is returned.
+
+template<class T>
+template <class Less>
+size_t grid<T>::argbest(size_t nthreads, Less less) const {
+  assert(nr > 0 && nc > 0);
+  const size_t n = nr * nc;
+  const size_t nt = std::min(utils_h::num_threads(nthreads),
+      std::max<size_t>(1, n / 32768));
+  std::vector<size_t> partial(nt);
+  utils_h::parallel_for(nt, nt, [&](size_t t0, size_t t1) {
+    for (size_t t = t0; t < t1; ++t) {
+      size_t best = n * t / nt;
+      const size_t last = n * (t + 1) / nt;
+      for (size_t i = best + 1; i < last; ++i) {
+        best = better(sto[i], sto[best], less) ? i : best;
+      }
+      partial[t] = best;
+    }
+  });
+  for (size_t t = 1; t < nt; ++t) {
+    if (better(sto[partial[t]], sto[partial[0]], less)) {
+      partial[0] = partial[t];
+    }
+  }
+  return partial[0];
+}
+
+template<class T>
+template <class Less>
+grid<size_t> grid<T>::argbest(along a, Less less) const {
+  if (a == along::columns) {
+    grid<size_t> tmp(1, nc);
+    for (size_t j = 0; j < nc; ++j) {
+      const T* col = sto.data() + j * nr;
+      size_t best = 0;
+      for (size_t i = 1; i < nr; ++i) {
+        best = better(col[i], col[best], less) ? i : best;
+      }
+      tmp(0, j) = best;
+    }
+    return tmp;
+  }
+  grid<size_t> tmp(nr, 1);
+  tmp.clear();
+  for (size_t j = 1; j < nc; ++j) {
+    for (size_t i = 0; i < nr; ++i) {
+      if (better((*this)(i, j), (*this)(i, tmp(i)), less)) {
+        tmp(i) = j;
+      }
+    }
+  }
+  return tmp;
+}
+
+template<class T>
+size_t grid<T>::argmin(size_t nthreads) const {
+  return argbest(nthreads, std::less<T>());
+}
+
+template<class T>
+size_t grid<T>::argmax(size_t nthreads) const {
+  return argbest(nthreads, std::greater<T>());
+}
+
+template<class T>
+grid<size_t> grid<T>::argmin(along a) const {
+  return argbest(a, std::less<T>());
+}
+
+template<class T>
+grid<size_t> grid<T>::argmax(along a) const {
+  return argbest(a, std::greater<T>());
+}
+
 // __________________________________________________________________________
 // Multiply two grids together using matrix multiplication.
 
 template<class T>
 grid<T> grid<T>::operator*(const grid &m) const {
+  GRID_INSTRUMENT_OP(multiply);
+  GRID_INSTRUMENT_COUNT(nr * m.nc, nr * m.nc * sizeof(T), 0);
   grid<T> tmp(nr, m.nc);
   assert(nc == m.nr);
   tmp.clear();
@@ -415,6 +899,8 @@ grid<T> grid<T>::operator*(const grid &m) const {
 
 template<class T>
 grid<T> grid<T>::LU() const {
+  GRID_INSTRUMENT_OP(lu);
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
   grid<T> tmp = *this;
   assert(nr == nc);
   if (nr > 0) {
@@ -434,6 +920,8 @@ grid<T> grid<T>::LU() const {
 
 template<class T>
 grid<T> grid<T>::inverse() const {
+  GRID_INSTRUMENT_OP(inverse);
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
   grid<T> tmp = *this;
   assert(nr == nc);
   grid<int> p(nr);
@@ -488,6 +976,8 @@ grid<T> grid<T>::inverse() const {
 
 template<class T>
 const grid<T> grid<T>::transpose() const {
+  GRID_INSTRUMENT_OP(transpose);
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
   grid<T> tp(nc, nr);
   for (size_t i = 0; i < nc; ++i)
     for (size_t j = 0; j < nr; ++j)
@@ -496,26 +986,172 @@ const grid<T> grid<T>::transpose() const {
 }
 
 // __________________________________________________________________________
-// Reorder all columns using the permutation that sorts a specified column.
+// Reorder all rows so that the key columns are sorted, comparing by the
+// first key and breaking ties with the following keys.  The sort is stable.
 
 template<class T>
-void grid<T>::sort(size_t col) {
+void grid<T>::sort_by(
+    const std::vector<size_t>& keys, bool descending, size_t nthreads) {
   if (storage().size() == 0) {
     return;
   }
-  auto col_start = begin() + col * rows();
-  std::vector<size_t> permutation(rows());
+  permute(argsort(keys, descending, nthreads), nthreads);
+}
+
+// __________________________________________________________________________
+// Find the permutation which stably sorts the rows by the key columns, so
+// that row i of the sorted grid is row permutation[i] of this grid.  The
+// same permutation can be applied to other grids with permute().  Integer
+// and floating point keys are radix sorted; negative zero sorts before
+// zero.
+
+template<class T>
+std::vector<size_t> grid<T>::argsort(
+    const std::vector<size_t>& keys, bool descending, size_t nthreads) const {
+  std::vector<size_t> permutation(nr);
   std::iota(permutation.begin(), permutation.end(), 0);
-  std::sort(permutation.begin(), permutation.end(),
-      [col_start](size_t i, size_t j) {
-        return *(col_start + i) < *(col_start + j); });
-  std::vector<T> tmp(rows());
-  auto pos = begin();
-  for (size_t j = 0; j < cols(); ++j) {
-    std::copy(pos, pos + rows(), tmp.begin());
-    for (auto ip = permutation.begin(); ip != permutation.end(); ++ip) {
-      *(pos++) = tmp[*ip];
+  for (auto k : keys) {
+    assert(k < nc);
+  }
+  if constexpr (radix_traits<T>::sortable) {
+    // Least significant key first; each pass is stable.
+    for (auto k = keys.rbegin(); k != keys.rend(); ++k) {
+      radix_sort(&permutation, *k, descending, nthreads);
     }
+  } else {
+    merge_sort(&permutation, keys, descending, nthreads);
+  }
+  return permutation;
+}
+
+// __________________________________________________________________________
+// Reorder all columns so that row i becomes row permutation[i].  Columns
+// are gathered into new storage in parallel.
+
+template<class T>
+void grid<T>::permute(
+    const std::vector<size_t>& permutation, size_t nthreads) {
+  assert(permutation.size() == nr);
+  std::vector<T> tmp(nr * nc);
+  const size_t* p = permutation.data();
+  utils_h::parallel_for(nc, nthreads, [this, p, &tmp](size_t c0, size_t c1) {
+    for (size_t j = c0; j < c1; ++j) {
+      const T* src = sto.data() + j * nr;
+      T* dst = tmp.data() + j * nr;
+      for (size_t i = 0; i < nr; ++i) {
+        dst[i] = src[p[i]];
+      }
+    }
+  });
+  std::swap(sto, tmp);
+}
+
+// __________________________________________________________________________
+// Stably reorder a permutation by one column using a least significant
+// digit radix sort, one byte per pass.  Each pass counts digits over
+// contiguous chunks in parallel and then scatters each chunk to the
+// offsets reserved for it.
+
+template<class T>
+void grid<T>::radix_sort(std::vector<size_t>* permutation, size_t col,
+    bool descending, size_t nthreads) const {
+  typedef typename radix_traits<T>::key_type U;
+  const size_t nt = std::min(utils_h::num_threads(nthreads),
+      std::max<size_t>(1, nr / 4096));
+  const T* c = sto.data() + col * nr;
+  std::vector<U> key(nr), key2(nr);
+  std::vector<size_t> perm2(nr);
+  std::vector<size_t>& perm = *permutation;
+  for (size_t i = 0; i < nr; ++i) {
+    key[i] = radix_key(c[perm[i]], descending);
+  }
+
+  std::vector<size_t> count(nt * 256);
+  for (size_t shift = 0; shift < 8 * sizeof(U); shift += 8) {
+    std::fill(count.begin(), count.end(), 0);
+    utils_h::parallel_for(nt, nt, [&](size_t t0, size_t t1) {
+      for (size_t t = t0; t < t1; ++t) {
+        for (size_t i = nr * t / nt; i < nr * (t + 1) / nt; ++i) {
+          ++count[t * 256 + ((key[i] >> shift) & 255)];
+        }
+      }
+    });
+
+    // Skip the pass if every key has the same digit.  Otherwise turn the
+    // counts into starting offsets, ordered by digit and then by chunk.
+    size_t sum = 0;
+    bool trivial = false;
+    for (size_t d = 0; d < 256 && !trivial; ++d) {
+      size_t dsum = 0;
+      for (size_t t = 0; t < nt; ++t) {
+        dsum += count[t * 256 + d];
+      }
+      trivial = dsum == nr;
+    }
+    if (trivial) {
+      continue;
+    }
+    for (size_t d = 0; d < 256; ++d) {
+      for (size_t t = 0; t < nt; ++t) {
+        const size_t n = count[t * 256 + d];
+        count[t * 256 + d] = sum;
+        sum += n;
+      }
+    }
+
+    utils_h::parallel_for(nt, nt, [&](size_t t0, size_t t1) {
+      for (size_t t = t0; t < t1; ++t) {
+        for (size_t i = nr * t / nt; i < nr * (t + 1) / nt; ++i) {
+          const size_t pos = count[t * 256 + ((key[i] >> shift) & 255)]++;
+          key2[pos] = key[i];
+          perm2[pos] = perm[i];
+        }
+      }
+    });
+    std::swap(key, key2);
+    std::swap(perm, perm2);
+  }
+}
+
+// __________________________________________________________________________
+// Stably sort a permutation by several columns with a comparison sort.
+// Contiguous chunks are sorted in parallel and then merged pairwise.
+
+template<class T>
+void grid<T>::merge_sort(std::vector<size_t>* permutation,
+    const std::vector<size_t>& keys, bool descending, size_t nthreads) const {
+  auto less = [this, &keys, descending](size_t i, size_t j) {
+    for (auto k : keys) {
+      const T& a = sto[k * nr + i];
+      const T& b = sto[k * nr + j];
+      if (a < b) {
+        return !descending;
+      } else if (b < a) {
+        return descending;
+      }
+    }
+    return false;
+  };
+  const size_t nt = std::min(utils_h::num_threads(nthreads),
+      std::max<size_t>(1, nr / 4096));
+  auto first = permutation->begin();
+  auto bound = [this, nt, first](size_t t) {
+    return first + nr * std::min(t, nt) / nt;
+  };
+  utils_h::parallel_for(nt, nt, [&](size_t t0, size_t t1) {
+    for (size_t t = t0; t < t1; ++t) {
+      std::stable_sort(bound(t), bound(t + 1), less);
+    }
+  });
+  for (size_t width = 1; width < nt; width *= 2) {
+    const size_t npairs = (nt + 2 * width - 1) / (2 * width);
+    utils_h::parallel_for(npairs, npairs, [&](size_t p0, size_t p1) {
+      for (size_t p = p0; p < p1; ++p) {
+        const size_t t = 2 * width * p;
+        std::inplace_merge(bound(t), bound(t + width), bound(t + 2 * width),
+            less);
+      }
+    });
   }
 }
 
@@ -523,6 +1159,7 @@ void grid<T>::sort(size_t col) {
 
 template <class T>
 int grid<T>::loadpgm(const std::string& pgmname) {
+  GRID_INSTRUMENT_OP(loadpgm);
   Ifstream(ifs, pgmname);
   if (!ifs) {
     return 0;
@@ -560,6 +1197,7 @@ int grid<T>::loadpgm(const std::string& pgmname) {
   }
 
   resize(r, c);
+  GRID_INSTRUMENT_COUNT(nr * nc, nr * nc * sizeof(T), nr * nc * sizeof(T));
   int i, j;
   switch (mode) {
     case 2:
@@ -583,15 +1221,23 @@ int grid<T>::loadpgm(const std::string& pgmname) {
       }
     break;
 
-    case 5:
-      for (j = 0; j < c; ++j) {
-        for (i = 0; i < r; ++i) {
-          char c;
-          ifs.read(&c, 1);
-          (*this)(i, j) = c;
-        }
+    case 5: {
+      // The raster is stored in the same order as a grid, so read it in
+      // one block.  Byte grids keep the bytes as they are, so signed char
+      // pixels above 127 wrap as they are saved; other grids read the
+      // raster and convert it in one pass.
+      if constexpr (std::is_integral<T>::value && sizeof(T) == 1 &&
+          !std::is_same<T, bool>::value) {
+        ifs.read(reinterpret_cast<char*>(sto.data()),
+            static_cast<std::streamsize>(sto.size()));
+      } else {
+        grid<unsigned char> raster(r, c);
+        ifs.read(reinterpret_cast<char*>(&*raster.begin()),
+            static_cast<std::streamsize>(raster.storage().size()));
+        convert_into(raster, this);
       }
       break;
+    }
 
     case 6:
       for (j=0; j < c; j++) {
@@ -617,10 +1263,12 @@ int grid<T>::loadpgm(const std::string& pgmname) {
 
 template <class T>
 int grid<T>::savepgm(const std::string& pgmname) {
+  GRID_INSTRUMENT_OP(savepgm);
   Ofstream(ofs, pgmname);
   if (!ofs) {
     return 0;
   }
+  GRID_INSTRUMENT_COUNT(nr * nc, 0, nr * nc);
   ofs << "P5\n" << nr << " " << nc << "\n255\n";
   for (size_t j = 0; j < nc; ++j) {
     for (size_t i = 0; i < nr; ++i) {
@@ -631,6 +1279,134 @@ int grid<T>::savepgm(const std::string& pgmname) {
   return 1;
 }
 
+// __________________________________________________________________________
+// The type in which a conversion from T to U is computed: float when both
+// types are exactly representable as float, and double otherwise.
+
+template <class T, class U>
+struct conversion_traits {
+  typedef typename std::conditional<
+      (std::is_same<T, float>::value ||
+          (std::is_integral<T>::value && sizeof(T) <= 2)) &&
+      (std::is_same<U, float>::value ||
+          (std::is_integral<U>::value && sizeof(U) <= 2)),
+      float, double>::type type;
+};
+
+// __________________________________________________________________________
+// Convert 'n' values with a * x + b, rounding with 'round' and, if
+// 'saturate', clamping to [lo, hi].  NaN clamps to 'lo', so saturation is
+// only used for integer U.  Each variant is a
+// separate branch free loop so that the compiler can vectorize it.
+
+template <class W, class T, class U, class Round>
+void convert_range(const T* src, U* dst, size_t n, W a, W b, W lo, W hi,
+    bool saturate, Round round) {
+  if (saturate) {
+    for (size_t i = 0; i < n; ++i) {
+      W x = round(a * static_cast<W>(src[i]) + b);
+      x = x > lo ? x : lo;
+      x = x < hi ? x : hi;
+      dst[i] = static_cast<U>(x);
+    }
+  } else {
+    for (size_t i = 0; i < n; ++i) {
+      dst[i] = static_cast<U>(round(a * static_cast<W>(src[i]) + b));
+    }
+  }
+}
+
+// __________________________________________________________________________
+// Convert the elements of 'm' to type U and store them in '*dst', reusing
+// its storage.  The affine map a * x + b is applied first.  Values
+// converted to an integer type are rounded as 'r' specifies and, if
+// 'saturate', clamped to the range of U, with NaN mapped to the lowest
+// value of U; otherwise out of range values have unspecified results.
+// Conversions to a floating point type keep NaN and infinities, and
+// integer to integer conversions without a map are exact.
+
+template <class U, class T>
+void convert_into(const grid<T>& m, grid<U>* dst,
+    rounding r = rounding::nearest, bool saturate = true,
+    double a = 1, double b = 0) {
+  static_assert(std::is_arithmetic<T>::value && std::is_arithmetic<U>::value,
+      "grid conversions need arithmetic element types");
+  dst->resize(m.rows(), m.cols());
+  const size_t n = m.storage().size();
+  if (n == 0) {
+    return;
+  }
+  const T* src = m.storage().data();
+  U* out = &*dst->begin();
+
+  // Integer to integer conversions without a map need no rounding, and
+  // are clamped in T to the part of U's range which T can represent.
+  if constexpr (std::is_integral<T>::value && std::is_integral<U>::value) {
+    if (a == 1 && b == 0) {
+      typedef std::numeric_limits<T> tlim;
+      typedef std::numeric_limits<U> ulim;
+      T lo = tlim::lowest();
+      if (!ulim::is_signed) {
+        lo = 0;
+      } else if (tlim::is_signed && sizeof(U) < sizeof(T)) {
+        lo = static_cast<T>(ulim::lowest());
+      }
+      T hi = tlim::max();
+      if (static_cast<uintmax_t>(ulim::max()) <
+          static_cast<uintmax_t>(tlim::max())) {
+        hi = static_cast<T>(ulim::max());
+      }
+      if (saturate) {
+        for (size_t i = 0; i < n; ++i) {
+          T x = src[i];
+          x = x > lo ? x : lo;
+          x = x < hi ? x : hi;
+          out[i] = static_cast<U>(x);
+        }
+      } else {
+        for (size_t i = 0; i < n; ++i) {
+          out[i] = static_cast<U>(src[i]);
+        }
+      }
+      return;
+    }
+  }
+
+  saturate = saturate && std::is_integral<U>::value;
+  typedef typename conversion_traits<T, U>::type W;
+  const W lo = std::numeric_limits<U>::lowest();
+  W hi = std::numeric_limits<U>::max();
+  if (std::numeric_limits<U>::digits > std::numeric_limits<W>::digits) {
+    // U's maximum rounds up in W, so use the largest W below it.
+    hi = std::nextafter(hi, W(0));
+  }
+  if (!std::is_integral<U>::value || r == rounding::truncate) {
+    // Conversion to an integer type truncates.
+    convert_range<W>(src, out, n, a, b, lo, hi, saturate,
+        [](W x) { return x; });
+  } else if (r == rounding::nearest) {
+    convert_range<W>(src, out, n, a, b, lo, hi, saturate,
+        [](W x) { return std::nearbyint(x); });
+  } else if (r == rounding::floor) {
+    convert_range<W>(src, out, n, a, b, lo, hi, saturate,
+        [](W x) { return std::floor(x); });
+  } else {
+    convert_range<W>(src, out, n, a, b, lo, hi, saturate,
+        [](W x) { return std::ceil(x); });
+  }
+}
+
+// __________________________________________________________________________
+// Return the elements of 'm' converted to type U, as for convert_into().
+
+template <class U, class T>
+grid<U> grid_cast(const grid<T>& m, rounding r = rounding::nearest,
+    bool saturate = true, double a = 1, double b = 0) {
+  grid<U> tmp;
+  convert_into(m, &tmp, r, saturate, a, b);
+  return tmp;
+}
+
 // __________________________________________________________________________
 //
 template<class T>
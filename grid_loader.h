@@ -0,0 +1,201 @@
+#ifndef GRID_LOADER_H_
+#define GRID_LOADER_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "grid.h"
+
+namespace grid_h {
+
+// A pipeline stage which reads a list of grid or pgm files with
+// grid<T>::read on a pool of I/O threads and hands each grid to a consumer
+// on the calling thread.  At most queue_depth() grids are in flight at
+// once, whether being read or waiting for the consumer.  Their buffers are
+// recycled across files and across calls to run(), so steady state loading
+// of grid files, and of binary pgm files into byte grids, does not
+// allocate; other pgm files are read through a temporary raster.  A
+// consumer which wants to keep a grid can take it with operator<<.  An exception thrown by the consumer, or by
+// grid<T>::read on an I/O thread, stops the readers and is rethrown by
+// run().
+
+template <class T>
+class grid_loader {
+ public:
+  struct metrics {
+    size_t files;  // files handed to the consumer
+    size_t failures;  // files which could not be read
+    size_t bytes;  // bytes of grid data loaded
+    double seconds;  // wall time of the run
+    size_t max_depth;  // most loaded grids waiting for the consumer
+    double mean_depth;  // mean number waiting when the consumer asks
+    double files_per_second() const {
+      return seconds > 0 ? files / seconds : 0;
+    }
+    double bytes_per_second() const {
+      return seconds > 0 ? bytes / seconds : 0;
+    }
+  };
+
+ private:
+  struct item {
+    int status;  // the result of grid<T>::read
+    std::unique_ptr<grid<T>> g;
+    std::exception_ptr error;  // thrown by grid<T>::read
+  };
+
+  size_t nthreads;  // number of I/O threads
+  size_t depth;  // number of grid buffers
+  std::vector<std::unique_ptr<grid<T>>> pool;  // free grid buffers
+  metrics stats;
+
+ public:
+  explicit grid_loader(size_t threads = 0, size_t queue_depth = 16)
+      : nthreads(utils_h::num_threads(threads)),
+        depth(std::max<size_t>(1, queue_depth)), stats() { }
+
+  size_t threads() const { return nthreads; }
+  size_t queue_depth() const { return depth; }
+  const metrics& last_metrics() const { return stats; }
+
+  template <class F>
+  void run(const std::vector<std::string>& files, F consumer,
+      bool ordered = true);
+};  // class grid_loader
+
+// __________________________________________________________________________
+// Load 'files', calling consumer(index, status, g) for each, where 'index'
+// is the position of the file in 'files', 'status' is the value returned
+// by grid<T>::read, and 'g' points to the grid.  Grids are delivered in
+// the order of 'files' if 'ordered', and otherwise as soon as they are
+// read.  The grid is recycled when the consumer returns.
+
+template <class T>
+template <class F>
+void grid_loader<T>::run(
+    const std::vector<std::string>& files, F consumer, bool ordered) {
+  const auto start = std::chrono::steady_clock::now();
+  stats = metrics();
+  while (pool.size() < depth) {
+    pool.push_back(std::unique_ptr<grid<T>>(new grid<T>));
+  }
+
+  std::mutex mu;
+  std::condition_variable freed, loaded;
+  size_t next = 0;  // index of the next file to read
+  std::map<size_t, item> done;  // grids waiting for the consumer
+
+  auto reader = [&]() {
+    for (;;) {
+      size_t index;
+      std::unique_ptr<grid<T>> g;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        freed.wait(lock, [&]() {
+          return !pool.empty() || next >= files.size(); });
+        if (next >= files.size()) {
+          return;
+        }
+        index = next++;
+        g = std::move(pool.back());
+        pool.pop_back();
+      }
+      int status = 0;
+      std::exception_ptr error;
+      try {
+        status = g->read(files[index].c_str());
+      } catch (...) {
+        error = std::current_exception();
+        g.reset(new grid<T>);  // 'g' may be left inconsistent
+      }
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        done.emplace(index, item{status, std::move(g), error});
+      }
+      loaded.notify_one();
+    }
+  };
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < std::min(nthreads, files.size()); ++t) {
+    readers.emplace_back(reader);
+  }
+
+  double depthsum = 0;
+  try {
+    for (size_t count = 0; count < files.size(); ++count) {
+      size_t index;
+      item it;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        depthsum += done.size();
+        loaded.wait(lock, [&]() {
+          return ordered ? done.count(count) > 0 : !done.empty(); });
+        stats.max_depth = std::max(stats.max_depth, done.size());
+        auto pos = ordered ? done.find(count) : done.begin();
+        index = pos->first;
+        it = std::move(pos->second);
+        done.erase(pos);
+      }
+      if (it.error) {
+        std::lock_guard<std::mutex> lock(mu);
+        pool.push_back(std::move(it.g));
+        std::rethrow_exception(it.error);
+      }
+      // The consumer may take the grid, so measure it first.
+      const size_t bytes = it.g->storage().size() * sizeof(T);
+      try {
+        consumer(index, it.status, it.g.get());
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mu);
+        pool.push_back(std::move(it.g));
+        throw;
+      }
+      ++stats.files;
+      if (it.status) {
+        stats.bytes += bytes;
+      } else {
+        ++stats.failures;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mu);
+        pool.push_back(std::move(it.g));
+      }
+      freed.notify_one();
+    }
+  } catch (...) {
+    // Stop the readers before letting the exception escape.  The grid
+    // being consumed has already been returned to the pool.
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      next = files.size();
+    }
+    freed.notify_all();
+    for (auto& th : readers) {
+      th.join();
+    }
+    for (auto& el : done) {
+      pool.push_back(std::move(el.second.g));
+    }
+    throw;
+  }
+  for (auto& th : readers) {
+    th.join();
+  }
+
+  stats.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  stats.mean_depth = files.empty() ? 0 : depthsum / files.size();
+}
+
+};  // namespace grid_h
+
+#endif  // GRID_LOADER_H_
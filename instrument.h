@@ -0,0 +1,267 @@
+#ifndef INSTRUMENT_H_
+#define INSTRUMENT_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace grid_h {
+
+// __________________________________________________________________________
+// Per-operation instrumentation of grid.  When GRID_INSTRUMENT is defined,
+// instrumented operations count their calls, elements, bytes allocated and
+// copied, and wall time into counters owned by the calling thread.
+// grid_profile::snapshot() merges the counters of all threads.  Otherwise
+// the instrumentation macros expand to nothing, and snapshots are zero.
+// Time spent in nested instrumented operations (such as a loadpgm called
+// by read) is counted in each of them.
+
+#ifdef GRID_INSTRUMENT
+#define GRID_INSTRUMENT_OP(op) \
+  grid_h::op_timer grid_op_timer_(grid_h::grid_op::op)
+#define GRID_INSTRUMENT_COUNT(elements, allocated, copied) \
+  grid_op_timer_.count(elements, allocated, copied)
+#else
+#define GRID_INSTRUMENT_OP(op)
+#define GRID_INSTRUMENT_COUNT(elements, allocated, copied)
+#endif
+
+enum class grid_op {
+  multiply, lu, inverse, transpose, subgrid, read, write, loadpgm, savepgm
+};
+const size_t grid_op_count = 9;
+
+inline const char* grid_op_name(grid_op op) {
+  static const char* const names[grid_op_count] = {
+    "multiply", "lu", "inverse", "transpose", "subgrid", "read", "write",
+    "loadpgm", "savepgm"
+  };
+  return names[static_cast<size_t>(op)];
+}
+
+struct op_stats {
+  uint64_t calls;
+  uint64_t elements;
+  uint64_t bytes_allocated;
+  uint64_t bytes_copied;
+  uint64_t nanoseconds;
+};
+
+// A snapshot of the counters of every operation.
+
+class grid_profile {
+ private:
+  static const size_t nfields = 5;
+  typedef std::array<std::array<uint64_t, nfields>, grid_op_count> totals;
+
+  // The counters of one thread.  Only the owning thread writes them, so
+  // updates need no read-modify-write; they are atomic only so that other
+  // threads can take snapshots.  A thread's counts are retired into the
+  // registry when it exits.
+  struct counters {
+    std::array<std::array<std::atomic<uint64_t>, nfields>, grid_op_count> v;
+    counters();
+    ~counters();
+    void add(totals* t) const;
+  };
+
+  struct registry {
+    registry() : retired(), baseline() { }
+    std::mutex mu;
+    std::vector<const counters*> live;
+    totals retired, baseline;
+  };
+
+  std::array<op_stats, grid_op_count> ops;
+
+  static registry& global() {
+    static registry r;
+    return r;
+  }
+  static counters& local() {
+    thread_local counters c;
+    return c;
+  }
+  static totals current();  // requires global().mu
+
+  friend class op_timer;
+  static void record(grid_op op, const std::array<uint64_t, nfields>& x);
+
+ public:
+  grid_profile() : ops() { }
+
+  static constexpr bool enabled() {
+#ifdef GRID_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+  }
+  static grid_profile snapshot();
+  static void reset();
+
+  const op_stats& operator[](grid_op op) const {
+    return ops[static_cast<size_t>(op)];
+  }
+  void write_text(std::ostream& os) const;
+  void write_json(std::ostream& os) const;
+};  // class grid_profile
+
+// __________________________________________________________________________
+// Times an operation from construction to destruction, and records it
+// with the counts given to count().
+
+class op_timer {
+ private:
+  grid_op op;
+  uint64_t elements, allocated, copied;
+  std::chrono::steady_clock::time_point start;
+
+ public:
+  explicit op_timer(grid_op o)
+      : op(o), elements(0), allocated(0), copied(0),
+        start(std::chrono::steady_clock::now()) { }
+  op_timer(const op_timer&) = delete;
+  op_timer& operator=(const op_timer&) = delete;
+  ~op_timer() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    grid_profile::record(op, {1, elements, allocated, copied,
+        static_cast<uint64_t>(ns)});
+  }
+  void count(uint64_t e, uint64_t a, uint64_t c) {
+    elements += e;
+    allocated += a;
+    copied += c;
+  }
+};  // class op_timer
+
+// __________________________________________________________________________
+
+inline grid_profile::counters::counters() {
+  for (auto& op : v)
+    for (auto& field : op)
+      field.store(0, std::memory_order_relaxed);
+  registry& r = global();
+  std::lock_guard<std::mutex> lock(r.mu);
+  r.live.push_back(this);
+}
+
+inline grid_profile::counters::~counters() {
+  registry& r = global();
+  std::lock_guard<std::mutex> lock(r.mu);
+  add(&r.retired);
+  for (auto it = r.live.begin(); it != r.live.end(); ++it) {
+    if (*it == this) {
+      r.live.erase(it);
+      break;
+    }
+  }
+}
+
+inline void grid_profile::counters::add(totals* t) const {
+  for (size_t i = 0; i < grid_op_count; ++i)
+    for (size_t f = 0; f < nfields; ++f)
+      (*t)[i][f] += v[i][f].load(std::memory_order_relaxed);
+}
+
+// __________________________________________________________________________
+// Add to the calling thread's counters for an operation.
+
+inline void grid_profile::record(
+    grid_op op, const std::array<uint64_t, nfields>& x) {
+  auto& c = local().v[static_cast<size_t>(op)];
+  for (size_t f = 0; f < nfields; ++f) {
+    c[f].store(c[f].load(std::memory_order_relaxed) + x[f],
+        std::memory_order_relaxed);
+  }
+}
+
+// __________________________________________________________________________
+// Sum the counters of exited and running threads.
+
+inline grid_profile::totals grid_profile::current() {
+  registry& r = global();
+  totals t = r.retired;
+  for (auto c : r.live)
+    c->add(&t);
+  return t;
+}
+
+// __________________________________________________________________________
+// Return the counts since the last reset().
+
+inline grid_profile grid_profile::snapshot() {
+  registry& r = global();
+  std::lock_guard<std::mutex> lock(r.mu);
+  const totals t = current();
+  grid_profile p;
+  for (size_t i = 0; i < grid_op_count; ++i) {
+    const auto& x = t[i];
+    const auto& b = r.baseline[i];
+    p.ops[i] = op_stats{x[0] - b[0], x[1] - b[1], x[2] - b[2], x[3] - b[3],
+        x[4] - b[4]};
+  }
+  return p;
+}
+
+// __________________________________________________________________________
+// Start counting again from zero.  Threads keep their own counters, so
+// this records the current totals as a baseline for later snapshots.
+
+inline void grid_profile::reset() {
+  registry& r = global();
+  std::lock_guard<std::mutex> lock(r.mu);
+  r.baseline = current();
+}
+
+// __________________________________________________________________________
+// Write one line per operation which has been called.  The formatting
+// state of 'os' is restored afterwards.
+
+inline void grid_profile::write_text(std::ostream& os) const {
+  const std::ios_base::fmtflags flags = os.flags();
+  const std::streamsize precision = os.precision();
+  os << std::left << std::setw(10) << "op" << std::right
+    << std::setw(10) << "calls" << std::setw(14) << "elements"
+    << std::setw(14) << "allocated" << std::setw(14) << "copied"
+    << std::setw(12) << "ms" << "\n";
+  for (size_t i = 0; i < grid_op_count; ++i) {
+    const op_stats& s = ops[i];
+    if (s.calls == 0)
+      continue;
+    os << std::left << std::setw(10) << grid_op_name(grid_op(i))
+      << std::right << std::setw(10) << s.calls
+      << std::setw(14) << s.elements << std::setw(14) << s.bytes_allocated
+      << std::setw(14) << s.bytes_copied << std::setw(12) << std::fixed
+      << std::setprecision(3) << s.nanoseconds / 1e6 << "\n";
+  }
+  os.flags(flags);
+  os.precision(precision);
+}
+
+// __________________________________________________________________________
+// Write every operation as a JSON object keyed by operation name.
+
+inline void grid_profile::write_json(std::ostream& os) const {
+  os << "{";
+  for (size_t i = 0; i < grid_op_count; ++i) {
+    const op_stats& s = ops[i];
+    os << (i ? ", " : "") << "\"" << grid_op_name(grid_op(i)) << "\": {"
+      << "\"calls\": " << s.calls
+      << ", \"elements\": " << s.elements
+      << ", \"bytes_allocated\": " << s.bytes_allocated
+      << ", \"bytes_copied\": " << s.bytes_copied
+      << ", \"nanoseconds\": " << s.nanoseconds << "}";
+  }
+  os << "}";
+}
+
+};  // namespace grid_h
+
+#endif  // INSTRUMENT_H_
@@ -0,0 +1,419 @@
+#ifndef PAGED_GRID_H_
+#define PAGED_GRID_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "grid.h"
+
+namespace grid_h {
+
+// An out-of-core grid backed by a tiled file.  The grid is divided into
+// tiles of tile_rows() x tile_cols() elements which are read on demand into
+// a least recently used cache of bounded size; modified tiles are written
+// back when evicted, on flush(), and on close().
+//
+// The file starts with "GT11" and the number of rows, columns, tile rows
+// and tile columns, followed by every tile in column major tile order.
+// Each tile is column major and padded to its full size.  All values are
+// stored in native byte order.
+//
+// operator() returns a reference object which looks its element up on
+// each use, so it stays valid when the element's tile is evicted.  Only
+// assignments through it mark the tile as modified; reading it, get(), and
+// for_each_tile() leave the tile clean, so read-only scans cause no writes.
+
+template <class T>
+class paged_grid {
+ private:
+  struct tile {
+    grid<T> data;
+    bool dirty;
+    std::list<size_t>::iterator pos;  // position in 'lru'
+  };
+
+  size_t nr, nc;  // number of rows, columns
+  size_t tr, tc;  // number of rows, columns in each tile
+  size_t ntr, ntc;  // number of tiles down, across the grid
+  std::fstream fs;
+  std::string filename;
+  std::unordered_map<size_t, tile> cache;
+  std::list<size_t> lru;  // cached tile ids, most recently used first
+  size_t cachebytes, maxtiles, readahead;
+  size_t nhits, nmisses, nevictions, nwritebacks;
+  size_t lastid;  // id of the most recently used tile, if 'last'
+  tile* last;
+
+  static constexpr size_t header = 4 + 4 * sizeof(size_t);
+
+  // Consistency Checking Functions
+  int inrange(size_t r, size_t c) const { return r < nr && c < nc; }
+
+  size_t tilebytes() const { return tr * tc * sizeof(T); }
+  size_t tileid(size_t r, size_t c) const { return (c / tc) * ntr + r / tr; }
+  void setup(size_t r, size_t c, size_t tile_rows, size_t tile_cols);
+  tile& fetch(size_t id);
+  tile& load(size_t id);
+  void evict();
+  void writeback(size_t id, tile* t);
+
+ public:
+  // Constructors, Destructor
+  explicit paged_grid(size_t cache_bytes = 64 << 20) : readahead(0) {
+    setup(0, 0, 1, 1);
+    set_cache_bytes(cache_bytes);
+  }
+  paged_grid(const paged_grid&) = delete;
+  paged_grid& operator=(const paged_grid&) = delete;
+  ~paged_grid() { close(); }
+
+  // I/O Functions
+  int create(const std::string& file, size_t r, size_t c,
+      size_t tile_rows, size_t tile_cols);
+  int open(const std::string& file);
+  void flush();
+  int close();
+
+  // Basic Member Access Functions
+  size_t rows() const { return nr; }
+  size_t cols() const { return nc; }
+  size_t tile_rows() const { return tr; }
+  size_t tile_cols() const { return tc; }
+  class reference;
+  reference operator()(size_t r, size_t c) {
+    assert(inrange(r, c));
+    return reference(this, r, c);
+  }
+  T get(size_t r, size_t c) {
+    return inrange(r, c) ? fetch(tileid(r, c)).data(r % tr, c % tc) : 0;
+  }
+  void set(size_t r, size_t c, T v) {
+    assert(inrange(r, c));
+    tile& t = fetch(tileid(r, c));
+    t.dirty = true;
+    t.data(r % tr, c % tc) = v;
+  }
+
+  // Cache Control Functions
+  void set_cache_bytes(size_t bytes);
+  void set_readahead(size_t ntiles) { readahead = ntiles; }
+  size_t cache_bytes() const { return cachebytes; }
+  size_t hits() const { return nhits; }
+  size_t misses() const { return nmisses; }
+  size_t evictions() const { return nevictions; }
+  size_t writebacks() const { return nwritebacks; }
+  void reset_counters() { nhits = nmisses = nevictions = nwritebacks = 0; }
+
+  // Tile Iteration and Reductions.  'f' is called as f(r, c, tile) for
+  // each tile in file order, where (r, c) is the position of the tile's
+  // first element.  Elements of edge tiles beyond rows() or cols() are
+  // padding.
+  template <class F> void for_each_tile(F f);
+  template <class F> void modify_tiles(F f);
+  size_t offpixels();
+  size_t onpixels() { return nr * nc - offpixels(); }
+  std::pair<T, T> minmax();
+};  // class paged_grid
+
+// __________________________________________________________________________
+// An element of a paged_grid, read with get() and written with set().
+
+template <class T>
+class paged_grid<T>::reference {
+ private:
+  friend class paged_grid;
+  paged_grid* pg;
+  size_t r, c;
+  reference(paged_grid* p, size_t i, size_t j) : pg(p), r(i), c(j) { }
+
+ public:
+  operator T() const { return pg->get(r, c); }
+  reference& operator=(T v) { pg->set(r, c, v); return *this; }
+  reference& operator=(const reference& x) { return *this = T(x); }
+  reference& operator+=(T v) { return *this = T(*this) + v; }
+  reference& operator-=(T v) { return *this = T(*this) - v; }
+  reference& operator*=(T v) { return *this = T(*this) * v; }
+  reference& operator/=(T v) { return *this = T(*this) / v; }
+};  // class paged_grid::reference
+
+// __________________________________________________________________________
+// Reset the dimensions and the cache, keeping the cache settings.
+
+template <class T>
+void paged_grid<T>::setup(
+    size_t r, size_t c, size_t tile_rows, size_t tile_cols) {
+  assert(tile_rows > 0 && tile_cols > 0);
+  nr = r;
+  nc = c;
+  tr = tile_rows;
+  tc = tile_cols;
+  ntr = (nr + tr - 1) / tr;
+  ntc = (nc + tc - 1) / tc;
+  cache.clear();
+  lru.clear();
+  last = nullptr;
+  reset_counters();
+}
+
+// __________________________________________________________________________
+// Set the cache budget in bytes.  At least one tile is always cached.
+
+template <class T>
+void paged_grid<T>::set_cache_bytes(size_t bytes) {
+  cachebytes = bytes;
+  maxtiles = std::max<size_t>(1, bytes / tilebytes());
+  while (cache.size() > maxtiles)
+    evict();
+}
+
+// __________________________________________________________________________
+// Create a zero filled tiled file for an 'r' x 'c' grid and open it.
+
+template <class T>
+int paged_grid<T>::create(const std::string& file, size_t r, size_t c,
+    size_t tile_rows, size_t tile_cols) {
+  close();
+  fs.open(file, std::ios::in | std::ios::out | std::ios::trunc |
+      std::ios::binary);
+  if (!fs) {
+    std::cerr << "Unable to create a paged grid in file [" << file << "]."
+      << std::endl;
+    return 0;
+  }
+  filename = file;
+  setup(r, c, tile_rows, tile_cols);
+  set_cache_bytes(cachebytes);
+  fs.write("GT11", 4);
+  for (size_t v : {nr, nc, tr, tc})
+    fs.write(reinterpret_cast<const char*>(&v), sizeof(v));
+
+  // Extend the file to its full size without writing the zero tiles.
+  const size_t ntiles = ntr * ntc;
+  if (ntiles > 0) {
+    fs.seekp(header + ntiles * tilebytes() - 1);
+    fs.put(0);
+  }
+  fs.flush();
+  return fs ? 1 : 0;
+}
+
+// __________________________________________________________________________
+// Open an existing tiled file.
+
+template <class T>
+int paged_grid<T>::open(const std::string& file) {
+  close();
+  fs.open(file, std::ios::in | std::ios::out | std::ios::binary);
+  if (!fs)
+    return 0;
+
+  char version[4];
+  size_t dims[4];
+  fs.read(version, 4);
+  fs.read(reinterpret_cast<char*>(dims), sizeof(dims));
+  if (!fs || memcmp(version, "GT11", 4) != 0 || dims[2] == 0 ||
+      dims[3] == 0) {
+    std::cerr << "The file [" << file << "] is not a paged grid file"
+      << std::endl;
+    fs.close();
+    return 0;
+  }
+  filename = file;
+  setup(dims[0], dims[1], dims[2], dims[3]);
+  set_cache_bytes(cachebytes);
+  return 1;
+}
+
+// __________________________________________________________________________
+// Write every modified tile back to the file.
+
+template <class T>
+void paged_grid<T>::flush() {
+  for (auto& el : cache)
+    writeback(el.first, &el.second);
+  fs.flush();
+}
+
+// __________________________________________________________________________
+// Flush and close the file, and empty the cache.  Unlike flush(), a failure
+// to write back a tile is reported rather than thrown, since close() is
+// called by the destructor.
+
+template <class T>
+int paged_grid<T>::close() {
+  int ok = 1;
+  if (fs.is_open()) {
+    try {
+      flush();
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      ok = 0;
+    }
+    fs.close();
+    fs.clear();
+  }
+  setup(0, 0, 1, 1);
+  return ok;
+}
+
+// __________________________________________________________________________
+// Find a tile, loading it on a miss.  If read-ahead is enabled, a miss
+// also loads the tiles that follow in the same tile column, stopping at
+// the first one which cannot be read.
+
+template <class T>
+typename paged_grid<T>::tile& paged_grid<T>::fetch(size_t id) {
+  if (last && lastid == id) {
+    ++nhits;
+    return *last;
+  }
+  auto it = cache.find(id);
+  if (it != cache.end()) {
+    ++nhits;
+    lru.splice(lru.begin(), lru, it->second.pos);
+    last = &it->second;
+  } else {
+    ++nmisses;
+    last = &load(id);
+    const size_t ahead =
+        std::min({readahead, ntr - 1 - id % ntr, maxtiles - 1});
+    try {
+      for (size_t k = 1; k <= ahead; ++k) {
+        if (cache.find(id + k) == cache.end())
+          load(id + k);
+      }
+    } catch (const std::runtime_error&) {
+      // Read-ahead is only a hint; a bad tile is reported when used.
+    }
+    lru.splice(lru.begin(), lru, last->pos);
+  }
+  lastid = id;
+  return *last;
+}
+
+// __________________________________________________________________________
+// Read a tile into the cache as its most recently used entry.
+
+template <class T>
+typename paged_grid<T>::tile& paged_grid<T>::load(size_t id) {
+  while (cache.size() >= maxtiles)
+    evict();
+  grid<T> data(tr, tc);
+  fs.seekg(header + id * tilebytes());
+  fs.read(reinterpret_cast<char*>(&*data.begin()), tilebytes());
+  if (!fs) {
+    fs.clear();
+    throw std::runtime_error("Unable to read a tile from " + filename);
+  }
+  lru.push_front(id);
+  tile& t = cache[id];
+  t.data << data;
+  t.dirty = false;
+  t.pos = lru.begin();
+  return t;
+}
+
+// __________________________________________________________________________
+// Remove the least recently used tile from the cache.
+
+template <class T>
+void paged_grid<T>::evict() {
+  const size_t id = lru.back();
+  auto it = cache.find(id);
+  writeback(id, &it->second);
+  if (last == &it->second)
+    last = nullptr;
+  lru.pop_back();
+  cache.erase(it);
+  ++nevictions;
+}
+
+// __________________________________________________________________________
+// Write a tile to the file if it has been modified.
+
+template <class T>
+void paged_grid<T>::writeback(size_t id, tile* t) {
+  if (!t->dirty)
+    return;
+  fs.seekp(header + id * tilebytes());
+  fs.write(reinterpret_cast<const char*>(t->data.storage().data()),
+      tilebytes());
+  if (!fs) {
+    fs.clear();
+    throw std::runtime_error("Unable to write a tile to " + filename);
+  }
+  t->dirty = false;
+  ++nwritebacks;
+}
+
+// __________________________________________________________________________
+// Visit each tile in file order without modifying it.
+
+template <class T>
+template <class F>
+void paged_grid<T>::for_each_tile(F f) {
+  for (size_t id = 0; id < ntr * ntc; ++id) {
+    const tile& t = fetch(id);
+    f((id % ntr) * tr, (id / ntr) * tc, t.data);
+  }
+}
+
+// __________________________________________________________________________
+// Visit each tile in file order, marking it as modified.
+
+template <class T>
+template <class F>
+void paged_grid<T>::modify_tiles(F f) {
+  for (size_t id = 0; id < ntr * ntc; ++id) {
+    tile& t = fetch(id);
+    t.dirty = true;
+    f((id % ntr) * tr, (id / ntr) * tc, t.data);
+  }
+}
+
+// __________________________________________________________________________
+// Count the elements which are zero.
+
+template <class T>
+size_t paged_grid<T>::offpixels() {
+  size_t count = 0;
+  for_each_tile([this, &count](size_t r, size_t c, const grid<T>& t) {
+    const size_t numrows = std::min(tr, nr - r);
+    const size_t numcols = std::min(tc, nc - c);
+    for (size_t j = 0; j < numcols; ++j)
+      for (size_t i = 0; i < numrows; ++i)
+        count += (t(i, j) == 0);
+  });
+  return count;
+}
+
+// __________________________________________________________________________
+// Find the smallest and largest elements of a nonempty paged grid.
+
+template <class T>
+std::pair<T, T> paged_grid<T>::minmax() {
+  assert(nr > 0 && nc > 0);
+  std::pair<T, T> mm(get(0, 0), get(0, 0));
+  for_each_tile([this, &mm](size_t r, size_t c, const grid<T>& t) {
+    const size_t numrows = std::min(tr, nr - r);
+    const size_t numcols = std::min(tc, nc - c);
+    for (size_t j = 0; j < numcols; ++j) {
+      for (size_t i = 0; i < numrows; ++i) {
+        mm.first = std::min(mm.first, t(i, j));
+        mm.second = std::max(mm.second, t(i, j));
+      }
+    }
+  });
+  return mm;
+}
+
+};  // namespace grid_h
+
+#endif  // PAGED_GRID_H_
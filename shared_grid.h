@@ -0,0 +1,81 @@
+#ifndef SHARED_GRID_H_
+#define SHARED_GRID_H_
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "grid.h"
+
+namespace grid_h {
+
+// A copy-on-write handle to a grid.  Copies of a shared_grid share one
+// reference counted grid; the storage is duplicated only when a handle
+// whose grid is shared is accessed through a non-const member.  Const
+// access never branches, so read-only loops run as fast as on a grid.
+//
+// The reference count is atomic, so separate handles to the same grid may
+// be copied, read, and mutated from different threads.  As with any other
+// object, a single handle must not be mutated while another thread uses it.
+// Mutable references are only valid until the handle is next copied; see
+// edit().
+
+template <class T>
+class shared_grid {
+ private:
+  std::shared_ptr<grid<T>> g;  // never null
+
+  // Make this handle the only owner of its grid.  use_count() is a relaxed
+  // load, so when it shows that the other handles are gone, the fence
+  // orders the writes that follow after their reads of the grid.
+  void detach() {
+    if (g.use_count() > 1) {
+      g = std::make_shared<grid<T>>(*g);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+
+ public:
+  // Constructors
+  shared_grid() : g(std::make_shared<grid<T>>()) { }
+  shared_grid(size_t r, size_t c) : g(std::make_shared<grid<T>>(r, c)) { }
+  explicit shared_grid(const grid<T>& m) : g(std::make_shared<grid<T>>(m)) { }
+
+  // Set a shared_grid equal to 'm'; obliterate 'm'.
+  shared_grid& operator<<(grid<T>& m) {
+    g = std::make_shared<grid<T>>();
+    *g << m;
+    return *this;
+  }
+  bool operator==(const shared_grid& m) const {
+    return g == m.g || *g == *m.g;
+  }
+
+  // Basic Member Access Functions
+  size_t rows() const { return g->rows(); }
+  size_t cols() const { return g->cols(); }
+  const std::vector<T>& storage() const { return g->storage(); }
+  long use_count() const { return g.use_count(); }  // advisory
+
+  // Read-only access to the shared grid, and writable access to a grid
+  // owned by this handle alone.  Hoist these out of hot loops, but do not
+  // keep a reference from edit() or a non-const operator() across a copy
+  // of the handle: the copy shares the grid, so writes through the
+  // reference would change both handles.  Call edit() again after copying.
+  const grid<T>& view() const { return *g; }
+  grid<T>& edit() { detach(); return *g; }
+
+  typename std::vector<T>::const_iterator begin() const { return g->begin(); }
+  typename std::vector<T>::const_iterator end() const { return g->end(); }
+  const T& operator()(size_t r) const { return (*g)(r); }
+  const T& operator()(size_t r, size_t c) const { return (*g)(r, c); }
+  const T& operator[](size_t r) const { return (*g)[r]; }
+  T& operator()(size_t r) { return edit()(r); }
+  T& operator()(size_t r, size_t c) { return edit()(r, c); }
+  T& operator[](size_t r) { return edit()[r]; }
+};  // class shared_grid
+
+};  // namespace grid_h
+
+#endif  // SHARED_GRID_H_
@@ -0,0 +1,356 @@
+#ifndef SPARSE_GRID_H_
+#define SPARSE_GRID_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "grid.h"
+
+namespace grid_h {
+
+// A sparse grid in compressed sparse column (CSC) form.  Like grid<T>, the
+// layout is column major: the values stored for column j are
+// vals[colptr[j]] .. vals[colptr[j + 1] - 1], ordered by row.
+
+template <class T>
+class sparse_grid {
+ private:
+  size_t nr, nc;  // number of rows, columns
+  std::vector<size_t> colptr;  // offset of each column's first value
+  std::vector<size_t> rowind;  // row index of each stored value
+  std::vector<T> vals;  // stored values, column by column
+
+  // Consistency Checking Functions
+  int consistent() const {
+    return colptr.size() == nc + 1 && rowind.size() == vals.size() &&
+        colptr[nc] == vals.size();
+  }
+  int inrange(size_t r, size_t c) const { return r < nr && c < nc; }
+
+  void multiply_columns(const T* x, T* y, size_t c0, size_t c1) const;
+  static T dot(const grid<T>& a, const grid<T>& b) {
+    return std::inner_product(a.begin(), a.end(), b.begin(), T(0));
+  }
+
+ public:
+  // Constructors
+  sparse_grid() : nr(0), nc(0), colptr(1, 0) { }
+  sparse_grid(size_t r, size_t c) : nr(r), nc(c), colptr(c + 1, 0) { }
+  sparse_grid(size_t r, size_t c, const std::vector<size_t>& ri,
+      const std::vector<size_t>& ci, const std::vector<T>& v);
+  explicit sparse_grid(const grid<T>& m, T threshold = 0);
+
+  bool operator==(const sparse_grid& m) const {
+    return nr == m.nr && nc == m.nc && colptr == m.colptr &&
+        rowind == m.rowind && vals == m.vals;
+  }
+
+  // Basic Member Access Functions
+  size_t rows() const { return nr; }
+  size_t cols() const { return nc; }
+  size_t nonzeros() const { return vals.size(); }
+  const std::vector<size_t>& colptrs() const { return colptr; }
+  const std::vector<size_t>& rowindices() const { return rowind; }
+  const std::vector<T>& values() const { return vals; }
+  T operator()(size_t r, size_t c) const;
+
+  // Useful Utility Functions
+  grid<T> dense() const;
+  sparse_grid transpose() const;
+  grid<T> operator*(const grid<T>& m) const { return multiply(m, 1); }
+  grid<T> multiply(const grid<T>& m, size_t nthreads) const;
+  void multiply(const grid<T>& m, grid<T>* dst, size_t nthreads) const;
+  grid<T> cg(const grid<T>& b, T tol = 1e-10, size_t maxiter = 0,
+      size_t* iters = nullptr, size_t nthreads = 1) const;
+  grid<T> bicgstab(const grid<T>& b, T tol = 1e-10, size_t maxiter = 0,
+      size_t* iters = nullptr, size_t nthreads = 1) const;
+};  // class sparse_grid
+
+// __________________________________________________________________________
+// Build a sparse grid from (row, column, value) triplets.  Triplets may be
+// given in any order; duplicates are summed.
+
+template <class T>
+sparse_grid<T>::sparse_grid(size_t r, size_t c, const std::vector<size_t>& ri,
+    const std::vector<size_t>& ci, const std::vector<T>& v)
+    : nr(r), nc(c), colptr(c + 1, 0) {
+  assert(ri.size() == v.size() && ci.size() == v.size());
+  std::vector<size_t> permutation(v.size());
+  std::iota(permutation.begin(), permutation.end(), 0);
+  std::sort(permutation.begin(), permutation.end(),
+      [&ri, &ci](size_t i, size_t j) {
+        return ci[i] < ci[j] || (ci[i] == ci[j] && ri[i] < ri[j]); });
+  rowind.reserve(v.size());
+  vals.reserve(v.size());
+  size_t lastc = 0;
+  for (auto p : permutation) {
+    assert(inrange(ri[p], ci[p]));
+    if (!vals.empty() && lastc == ci[p] && rowind.back() == ri[p]) {
+      vals.back() += v[p];
+    } else {
+      rowind.push_back(ri[p]);
+      vals.push_back(v[p]);
+      ++colptr[ci[p] + 1];
+      lastc = ci[p];
+    }
+  }
+  std::partial_sum(colptr.begin(), colptr.end(), colptr.begin());
+  assert(consistent());
+}
+
+// __________________________________________________________________________
+// Build a sparse grid from the elements of 'm' whose magnitude exceeds
+// 'threshold'.
+
+template <class T>
+sparse_grid<T>::sparse_grid(const grid<T>& m, T threshold)
+    : nr(m.rows()), nc(m.cols()), colptr(m.cols() + 1, 0) {
+  for (size_t j = 0; j < nc; ++j) {
+    for (size_t i = 0; i < nr; ++i) {
+      const T el = m(i, j);
+      bool keep;
+      if constexpr (std::is_unsigned<T>::value) {
+        keep = el > threshold;
+      } else {
+        keep = std::abs(el) > threshold;
+      }
+      if (keep) {
+        rowind.push_back(i);
+        vals.push_back(el);
+      }
+    }
+    colptr[j + 1] = vals.size();
+  }
+}
+
+// __________________________________________________________________________
+// Look up a single element; elements which are not stored are zero.
+
+template <class T>
+T sparse_grid<T>::operator()(size_t r, size_t c) const {
+  assert(inrange(r, c));
+  auto first = rowind.begin() + colptr[c];
+  auto last = rowind.begin() + colptr[c + 1];
+  auto pos = std::lower_bound(first, last, r);
+  return (pos != last && *pos == r) ? vals[pos - rowind.begin()] : 0;
+}
+
+// __________________________________________________________________________
+// Expand a sparse grid into a dense grid.
+
+template <class T>
+grid<T> sparse_grid<T>::dense() const {
+  grid<T> tmp(nr, nc);
+  tmp.clear();
+  for (size_t j = 0; j < nc; ++j)
+    for (size_t p = colptr[j]; p < colptr[j + 1]; ++p)
+      tmp(rowind[p], j) = vals[p];
+  return tmp;
+}
+
+// __________________________________________________________________________
+// Transpose a sparse grid by counting the values stored in each row.
+
+template <class T>
+sparse_grid<T> sparse_grid<T>::transpose() const {
+  sparse_grid<T> tp(nc, nr);
+  tp.rowind.resize(nonzeros());
+  tp.vals.resize(nonzeros());
+  for (auto r : rowind)
+    ++tp.colptr[r + 1];
+  std::partial_sum(tp.colptr.begin(), tp.colptr.end(), tp.colptr.begin());
+  std::vector<size_t> next(tp.colptr.begin(), tp.colptr.end() - 1);
+  for (size_t j = 0; j < nc; ++j) {
+    for (size_t p = colptr[j]; p < colptr[j + 1]; ++p) {
+      const size_t q = next[rowind[p]]++;
+      tp.rowind[q] = j;
+      tp.vals[q] = vals[p];
+    }
+  }
+  return tp;
+}
+
+// __________________________________________________________________________
+// Accumulate columns [c0, c1) of the grid, weighted by 'x', into 'y'.
+
+template <class T>
+void sparse_grid<T>::multiply_columns(
+    const T* x, T* y, size_t c0, size_t c1) const {
+  for (size_t j = c0; j < c1; ++j) {
+    const T xj = x[j];
+    if (xj == 0)
+      continue;
+    for (size_t p = colptr[j]; p < colptr[j + 1]; ++p)
+      y[rowind[p]] += vals[p] * xj;
+  }
+}
+
+// __________________________________________________________________________
+// Multiply a sparse grid by a dense grid using up to 'nthreads' threads
+// (0 uses one thread per core).  The columns of a wide 'm' are divided
+// among the threads; for a single column each thread accumulates a
+// private partial product over a range of columns of the sparse grid.
+
+template <class T>
+grid<T> sparse_grid<T>::multiply(const grid<T>& m, size_t nthreads) const {
+  grid<T> tmp;
+  multiply(m, &tmp, nthreads);
+  return tmp;
+}
+
+// __________________________________________________________________________
+// Multiply as above into '*dst', reusing its storage.  'dst' must not be
+// 'm'.
+
+template <class T>
+void sparse_grid<T>::multiply(
+    const grid<T>& m, grid<T>* dst, size_t nthreads) const {
+  assert(nc == m.rows() && dst != &m);
+  dst->resize(nr, m.cols());
+  dst->clear();
+  if (dst->storage().empty())
+    return;
+  nthreads = utils_h::num_threads(nthreads);
+  const T* x = m.storage().data();
+  T* y = &*dst->begin();
+
+  if (nthreads == 1 || nr == 0 || nc == 0) {
+    for (size_t k = 0; k < m.cols(); ++k)
+      multiply_columns(x + k * nc, y + k * nr, 0, nc);
+    return;
+  }
+
+  if (m.cols() > 1) {
+    utils_h::parallel_for(m.cols(), nthreads,
+        [this, x, y](size_t k0, size_t k1) {
+          for (size_t k = k0; k < k1; ++k)
+            multiply_columns(x + k * nc, y + k * nr, 0, nc);
+        });
+    return;
+  }
+
+  nthreads = std::min(nthreads, nc);
+  std::vector<std::vector<T>> partial(nthreads - 1, std::vector<T>(nr));
+  utils_h::parallel_for(nthreads, nthreads,
+      [this, x, y, nthreads, &partial](size_t t0, size_t t1) {
+        for (size_t t = t0; t < t1; ++t) {
+          T* yt = t == 0 ? y : partial[t - 1].data();
+          multiply_columns(x, yt, nc * t / nthreads, nc * (t + 1) / nthreads);
+        }
+      });
+  for (const auto& part : partial)
+    for (size_t i = 0; i < nr; ++i)
+      y[i] += part[i];
+}
+
+// __________________________________________________________________________
+// Solve A x = b for a symmetric positive definite A using the conjugate
+// gradient method.  Iteration stops once |b - A x| <= tol * |b| or after
+// 'maxiter' iterations (0 means rows()).  The products with A use up to
+// 'nthreads' threads, as for multiply(), and reuse one buffer.
+
+template <class T>
+grid<T> sparse_grid<T>::cg(const grid<T>& b, T tol, size_t maxiter,
+    size_t* iters, size_t nthreads) const {
+  assert(nr == nc && b.rows() == nr && b.cols() == 1);
+  if (maxiter == 0)
+    maxiter = nr;
+  grid<T> x(nr);
+  x.clear();
+  grid<T> r = b;
+  grid<T> p = r;
+  grid<T> ap;
+  T rs = dot(r, r);
+  const T stop = tol * tol * rs;
+  size_t it = 0;
+  while (it < maxiter && rs > stop) {
+    ++it;
+    multiply(p, &ap, nthreads);
+    const T pap = dot(p, ap);
+    if (pap == 0) {
+      throw std::runtime_error("Conjugate gradient breakdown");
+    }
+    const T alpha = rs / pap;
+    for (size_t i = 0; i < nr; ++i) {
+      x(i) += alpha * p(i);
+      r(i) -= alpha * ap(i);
+    }
+    const T rsnew = dot(r, r);
+    const T beta = rsnew / rs;
+    for (size_t i = 0; i < nr; ++i)
+      p(i) = r(i) + beta * p(i);
+    rs = rsnew;
+  }
+  if (iters)
+    *iters = it;
+  return x;
+}
+
+// __________________________________________________________________________
+// Solve A x = b for a general nonsingular A using the stabilized
+// biconjugate gradient method.  Stopping rules and threads are as for
+// cg().
+
+template <class T>
+grid<T> sparse_grid<T>::bicgstab(const grid<T>& b, T tol, size_t maxiter,
+    size_t* iters, size_t nthreads) const {
+  assert(nr == nc && b.rows() == nr && b.cols() == 1);
+  if (maxiter == 0)
+    maxiter = nr;
+  grid<T> x(nr);
+  x.clear();
+  grid<T> r = b;
+  const grid<T> rhat = b;
+  grid<T> p(nr), v(nr), s(nr), t(nr);
+  p.clear();
+  v.clear();
+  T rho = 1, alpha = 1, omega = 1;
+  const T stop = tol * tol * dot(b, b);
+  size_t it = 0;
+  while (it < maxiter && dot(r, r) > stop) {
+    ++it;
+    const T rhonew = dot(rhat, r);
+    if (rhonew == 0) {
+      throw std::runtime_error("BiCGSTAB breakdown");
+    }
+    const T beta = (rhonew / rho) * (alpha / omega);
+    for (size_t i = 0; i < nr; ++i)
+      p(i) = r(i) + beta * (p(i) - omega * v(i));
+    multiply(p, &v, nthreads);
+    const T rv = dot(rhat, v);
+    if (rv == 0) {
+      throw std::runtime_error("BiCGSTAB breakdown");
+    }
+    alpha = rhonew / rv;
+    for (size_t i = 0; i < nr; ++i)
+      s(i) = r(i) - alpha * v(i);
+    if (dot(s, s) <= stop) {
+      for (size_t i = 0; i < nr; ++i)
+        x(i) += alpha * p(i);
+      r = s;
+      break;
+    }
+    multiply(s, &t, nthreads);
+    const T tt = dot(t, t);
+    omega = tt == 0 ? 0 : dot(t, s) / tt;
+    for (size_t i = 0; i < nr; ++i) {
+      x(i) += alpha * p(i) + omega * s(i);
+      r(i) = s(i) - omega * t(i);
+    }
+    if (omega == 0)
+      break;
+    rho = rhonew;
+  }
+  if (iters)
+    *iters = it;
+  return x;
+}
+
+};  // namespace grid_h
+
+#endif  // SPARSE_GRID_H_
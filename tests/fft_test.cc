@@ -0,0 +1,124 @@
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "fft.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::conv_mode;
+using grid_h::cplx;
+using grid_h::fft_plan;
+using grid_h::grid;
+
+// A deterministic pseudo-random grid of small values.
+grid<double> Pattern(size_t r, size_t c, uint32_t seed) {
+  grid<double> g(r, c);
+  for (size_t i = 0; i < r * c; ++i) {
+    seed = seed * 1664525 + 1013904223;
+    g[i] = static_cast<double>(seed >> 27) - 16;
+  }
+  return g;
+}
+
+// Direct convolution, for comparison.
+grid<double> Convolve(const grid<double>& m, const grid<double>& k) {
+  grid<double> c(m.rows() + k.rows() - 1, m.cols() + k.cols() - 1);
+  c.clear();
+  for (size_t j = 0; j < m.cols(); ++j)
+    for (size_t i = 0; i < m.rows(); ++i)
+      for (size_t v = 0; v < k.cols(); ++v)
+        for (size_t u = 0; u < k.rows(); ++u)
+          c(i + u, j + v) += m(i, j) * k(u, v);
+  return c;
+}
+
+void ExpectNear(const grid<double>& a, const grid<double>& b) {
+  ASSERT_EQ(a.rows(), b.rows());
+  ASSERT_EQ(a.cols(), b.cols());
+  for (size_t i = 0; i < a.storage().size(); ++i)
+    EXPECT_NEAR(a[i], b[i], 1e-8);
+}
+
+TEST(Fft, MatchesDft) {
+  for (size_t n = 1; n <= 40; ++n) {
+    std::vector<cplx> x(n), f(n);
+    for (size_t k = 0; k < n; ++k)
+      x[k] = cplx(std::cos(k * 1.3), std::sin(k * 0.7) + k % 3);
+    for (size_t k = 0; k < n; ++k)
+      for (size_t t = 0; t < n; ++t)
+        f[k] += x[t] * std::polar(1.0, -2 * std::acos(-1.0) * k * t / n);
+    std::vector<cplx> y = x;
+    fft_plan::cached(n, false).execute(y.data());
+    for (size_t k = 0; k < n; ++k)
+      EXPECT_NEAR(std::abs(y[k] - f[k]), 0, 1e-9) << "n = " << n;
+    fft_plan::cached(n, true).execute(y.data());
+    for (size_t k = 0; k < n; ++k)
+      EXPECT_NEAR(std::abs(y[k] / static_cast<double>(n) - x[k]), 0, 1e-9);
+  }
+}
+
+TEST(Fft, PlanCache) {
+  fft_plan::clear_cache();
+  fft_plan& p = fft_plan::cached(360, false);
+  EXPECT_EQ(&fft_plan::cached(360, false), &p);
+  EXPECT_NE(&fft_plan::cached(360, true), &p);
+  EXPECT_EQ(fft_plan::cache_size(), 2);
+}
+
+TEST(Fft, GoodSize) {
+  EXPECT_EQ(grid_h::fft_good_size(1), 1);
+  EXPECT_EQ(grid_h::fft_good_size(7), 8);
+  EXPECT_EQ(grid_h::fft_good_size(121), 125);
+}
+
+TEST(Fft, RealRoundTrip) {
+  for (size_t r : {1, 6, 7}) {
+    for (size_t c : {1, 4, 5}) {
+      grid<double> g = Pattern(r, c, r + c);
+      grid<cplx> f = grid_h::rfft2(g);
+      EXPECT_EQ(f.rows(), r / 2 + 1);
+      EXPECT_NEAR(f(0, 0).real(), g.sum(), 1e-9);
+      ExpectNear(grid_h::irfft2(f, r), g);
+    }
+  }
+}
+
+TEST(Fft, Convolve) {
+  grid<double> m = Pattern(13, 9, 1), k = Pattern(5, 4, 2);
+  grid<double> full = Convolve(m, k);
+  ExpectNear(grid_h::fft_convolve(m, k), full);
+
+  grid<double> same, valid;
+  full.subgrid(&same, 2, 1, 13, 9);
+  full.subgrid(&valid, 4, 3, 9, 6);
+  ExpectNear(grid_h::fft_convolve(m, k, conv_mode::same), same);
+  ExpectNear(grid_h::fft_convolve(m, k, conv_mode::valid), valid);
+}
+
+TEST(Fft, Correlate) {
+  grid<int> m(3, 3, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+  grid<int> t(2, 2, {1, 0, 0, 1});
+  ExpectNear(grid_h::correlate(m, t), grid<double>(2, 2, {6, 8, 12, 14}));
+}
+
+TEST(Fft, NormalizedCorrelate) {
+  grid<double> m = Pattern(40, 30, 3);
+  grid<double> t;
+  m.subgrid(&t, 11, 7, 16, 16);
+  t.scale(5) += 2;  // NCC ignores gain and offset.
+  grid<double> c = grid_h::normalized_correlate(m, t);
+  EXPECT_EQ(c.rows(), 25);
+  EXPECT_EQ(c.cols(), 15);
+  EXPECT_NEAR(c(11, 7), 1.0, 1e-9);
+  EXPECT_EQ(c.argmax(), 7 * c.rows() + 11);
+  EXPECT_GE(c.minmax().first, -1.0);
+
+  // Flat windows give zero.
+  grid<double> flat(20, 20);
+  flat.fill(3);
+  EXPECT_EQ(grid_h::normalized_correlate(flat, t), grid<double>(5, 5).clear());
+}
+
+}  // namespace
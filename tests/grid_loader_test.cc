@@ -0,0 +1,119 @@
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "grid_loader.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::grid;
+using grid_h::grid_loader;
+
+class GridLoaderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (int k = 0; k < 20; ++k) {
+      files.push_back(
+          ::testing::TempDir() + "grid_loader_" + std::to_string(k) + ".pgm");
+      grid<unsigned char>(4 + k, 3).fill(k).savepgm(files.back());
+    }
+  }
+  void TearDown() override {
+    for (const auto& file : files)
+      std::remove(file.c_str());
+  }
+  std::vector<std::string> files;
+};
+
+TEST_F(GridLoaderTest, Ordered) {
+  grid_loader<int> loader(4, 3);
+  std::vector<size_t> order;
+  loader.run(files, [&order](size_t index, int status, grid<int>* g) {
+    EXPECT_TRUE(status);
+    EXPECT_EQ(g->rows(), 4 + index);
+    EXPECT_EQ((*g)(0, 2), index);
+    order.push_back(index);
+  });
+  for (size_t k = 0; k < order.size(); ++k)
+    EXPECT_EQ(order[k], k);
+
+  const auto& m = loader.last_metrics();
+  EXPECT_EQ(m.files, 20);
+  EXPECT_EQ(m.failures, 0);
+  EXPECT_EQ(m.bytes, (4 * 20 + 190) * 3 * sizeof(int));
+  EXPECT_LE(m.max_depth, 3);
+}
+
+TEST_F(GridLoaderTest, AsCompleted) {
+  grid_loader<unsigned char> loader(3, 2);
+  std::vector<int> seen(files.size());
+  loader.run(files, [&seen](size_t index, int, grid<unsigned char>* g) {
+    EXPECT_EQ((*g)(1, 1), index);
+    ++seen[index];
+  }, false);
+  EXPECT_EQ(seen, std::vector<int>(files.size(), 1));
+}
+
+TEST_F(GridLoaderTest, KeepGridAndReportFailures) {
+  files.insert(files.begin() + 1, ::testing::TempDir() + "no_such_file.pgm");
+  grid_loader<int> loader(2, 2);
+  std::vector<grid<int>> kept(files.size());
+  loader.run(files, [&kept](size_t index, int status, grid<int>* g) {
+    EXPECT_EQ(status, index == 1 ? 0 : 1);
+    kept[index] << *g;
+  });
+  const auto& m = loader.last_metrics();
+  EXPECT_EQ(m.files, 21);
+  EXPECT_EQ(m.failures, 1);
+  EXPECT_EQ(m.bytes, (4 * 20 + 190) * 3 * sizeof(int));
+  EXPECT_GT(m.bytes_per_second(), 0);
+  EXPECT_EQ(kept[2], grid<int>(5, 3).fill(1));
+  EXPECT_EQ(kept[20], grid<int>(23, 3).fill(19));
+}
+
+TEST_F(GridLoaderTest, ConsumerException) {
+  grid_loader<int> loader(4, 4);
+  grid<int>* thrown = nullptr;
+  EXPECT_THROW(
+      loader.run(files, [&thrown](size_t index, int, grid<int>* g) {
+        if (index == 5) {
+          thrown = g;
+          throw std::runtime_error("stop");
+        }
+      }), std::runtime_error);
+  // Every buffer, including the one being consumed, is reused.
+  size_t count = 0;
+  std::set<grid<int>*> buffers;
+  loader.run(files, [&](size_t, int, grid<int>* g) {
+    ++count;
+    buffers.insert(g);
+  });
+  EXPECT_EQ(count, files.size());
+  EXPECT_EQ(buffers.size(), 4);
+  EXPECT_EQ(buffers.count(thrown), 1);
+}
+
+TEST_F(GridLoaderTest, ReaderException) {
+  // A grid header whose size does not fit in memory.
+  const std::string bad = ::testing::TempDir() + "grid_loader_bad.grid";
+  {
+    std::ofstream ofs(bad, std::ios::binary);
+    const size_t dims[2] = {size_t(1) << 31, size_t(1) << 31};
+    ofs.write("GR11", 4);
+    ofs.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+  }
+  files.insert(files.begin() + 3, bad);
+  grid_loader<int> loader(4, 4);
+  size_t count = 0;
+  EXPECT_THROW(
+      loader.run(files, [&count](size_t, int, grid<int>*) { ++count; }),
+      std::length_error);
+  EXPECT_EQ(count, 3);
+  std::remove(bad.c_str());
+}
+
+}  // namespace
@@ -1,9 +1,19 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+
 #include "grid.h"
 #include "gtest/gtest.h"
 
 namespace {
 
+using grid_h::along;
+using grid_h::convert_into;
 using grid_h::grid;
+using grid_h::grid_cast;
+using grid_h::rounding;
 
 TEST(Grid, ConstructorEmpty) {
   grid<int> g;
@@ -119,4 +129,213 @@ TEST(Grid, SortColumn) {
   EXPECT_EQ(gd, grid<int>(4, 2, {1, 2, 3, 4, 5, 7, 8, 6}));
 }
 
+TEST(Grid, SortByMultipleKeys) {
+  auto gd = grid<int>(4, 3, {2, 1, 2, 1, 9, 8, 7, 6, 0, 1, 2, 3});
+  gd.sort_by({0, 1});
+  EXPECT_EQ(gd, grid<int>(4, 3, {1, 1, 2, 2, 6, 8, 7, 9, 3, 1, 2, 0}));
+  gd.sort_by({0, 1}, true);
+  EXPECT_EQ(gd, grid<int>(4, 3, {2, 2, 1, 1, 9, 7, 8, 6, 0, 2, 1, 3}));
+}
+
+TEST(Grid, SortByIsStable) {
+  auto gd = grid<double>(5, 2, {1.5, -2, 1.5, -0.5, -2, 0, 1, 2, 3, 4});
+  gd.sort_by({0});
+  EXPECT_EQ(gd, grid<double>(5, 2, {-2, -2, -0.5, 1.5, 1.5, 1, 4, 3, 0, 2}));
+  gd.sort_by({0}, true);
+  EXPECT_EQ(gd, grid<double>(5, 2, {1.5, 1.5, -0.5, -2, -2, 0, 2, 3, 1, 4}));
+}
+
+TEST(Grid, ArgsortPermute) {
+  auto keys = grid<unsigned char>(3, 1, {30, 10, 20});
+  auto perm = keys.argsort({0});
+  EXPECT_EQ(perm, std::vector<size_t>({1, 2, 0}));
+  auto gd = grid<int>(3, 2, {1, 2, 3, 4, 5, 6});
+  gd.permute(perm);
+  EXPECT_EQ(gd, grid<int>(3, 2, {2, 3, 1, 5, 6, 4}));
+}
+
+TEST(Grid, SortByParallel) {
+  const size_t n = 50000;
+  grid<int> gi(n, 2);
+  grid<long double> gl(n, 2);
+  for (size_t i = 0; i < n; ++i) {
+    gi(i, 0) = gl(i, 0) = static_cast<int>((i * 7919) % 1000) - 500;
+    gi(i, 1) = gl(i, 1) = i;
+  }
+  std::vector<size_t> expected(n);
+  std::iota(expected.begin(), expected.end(), 0);
+  std::stable_sort(expected.begin(), expected.end(),
+      [&gi](size_t i, size_t j) { return gi(i, 0) < gi(j, 0); });
+
+  EXPECT_EQ(gi.argsort({0}, false, 4), expected);
+  EXPECT_EQ(gl.argsort({0}, false, 4), expected);
+  gi.sort_by({0}, false, 4);
+  gl.sort_by({0}, false, 4);
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(gi(i, 1), expected[i]);
+    EXPECT_EQ(gl(i, 1), expected[i]);
+  }
+}
+
+TEST(Grid, Sum) {
+  auto g = grid<int>(2, 3, {1, 2, 3, 4, 5, 6});
+  EXPECT_EQ(g.sum(), 21);
+  EXPECT_EQ(g.sum(along::columns), grid<int64_t>(1, 3, {3, 7, 11}));
+  EXPECT_EQ(g.sum(along::rows), grid<int64_t>(2, 1, {9, 12}));
+  EXPECT_EQ(grid<int>().sum(), 0);
+
+  // Small integer types are widened.
+  EXPECT_EQ(grid<unsigned char>(100, 100).fill(255).sum(), 2550000);
+}
+
+TEST(Grid, SumCompensated) {
+  grid<float> g(100001);
+  g.fill(0.1f);
+  g(0) = 1e8f;
+  EXPECT_NEAR(g.sum(), 1e8 + 10000 * 1.0000000149, 1e-3);
+  EXPECT_NEAR(g.sum(4), 1e8 + 10000 * 1.0000000149, 1e-3);
+}
+
+TEST(Grid, MeanVarianceNorm) {
+  auto g = grid<double>(2, 2, {1, 3, 2, 6});
+  EXPECT_DOUBLE_EQ(g.mean(), 3.0);
+  EXPECT_DOUBLE_EQ(g.variance(), 3.5);
+  EXPECT_DOUBLE_EQ(g.norm(), std::sqrt(50.0));
+  EXPECT_EQ(g.mean(along::columns), grid<double>(1, 2, {2, 4}));
+  EXPECT_EQ(g.mean(along::rows), grid<double>(2, 1, {1.5, 4.5}));
+  EXPECT_EQ(g.variance(along::columns), grid<double>(1, 2, {1, 4}));
+  EXPECT_EQ(g.variance(along::rows), grid<double>(2, 1, {0.25, 2.25}));
+  EXPECT_EQ(g.norm(along::rows),
+            grid<double>(2, 1, {std::sqrt(5.0), std::sqrt(45.0)}));
+}
+
+TEST(Grid, MinMax) {
+  auto g = grid<int>(2, 3, {4, -1, 7, 2, 0, 9});
+  EXPECT_EQ(g.minmax(), std::make_pair(-1, 9));
+  EXPECT_EQ(g.argmin(), 1);
+  EXPECT_EQ(g.argmax(), 5);
+  auto cols = g.minmax(along::columns);
+  EXPECT_EQ(cols.first, grid<int>(1, 3, {-1, 2, 0}));
+  EXPECT_EQ(cols.second, grid<int>(1, 3, {4, 7, 9}));
+  auto rows = g.minmax(along::rows);
+  EXPECT_EQ(rows.first, grid<int>(2, 1, {0, -1}));
+  EXPECT_EQ(rows.second, grid<int>(2, 1, {7, 9}));
+  EXPECT_EQ(g.argmin(along::columns), grid<size_t>(1, 3, {1, 1, 0}));
+  EXPECT_EQ(g.argmax(along::rows), grid<size_t>(2, 1, {1, 2}));
+}
+
+TEST(Grid, MinMaxIgnoresNan) {
+  const double nan = std::nan("");
+  const double inf = std::numeric_limits<double>::infinity();
+  auto g = grid<double>(3, 2, {nan, 1, -2, inf, nan, 0});
+  EXPECT_EQ(g.minmax(), std::make_pair(-2.0, inf));
+  EXPECT_EQ(g.argmin(), 2);
+  EXPECT_EQ(g.argmax(), 3);
+  auto cols = g.minmax(along::columns);
+  EXPECT_EQ(cols.first, grid<double>(1, 2, {-2, 0}));
+  EXPECT_EQ(cols.second, grid<double>(1, 2, {1, inf}));
+  EXPECT_EQ(g.argmin(along::columns), grid<size_t>(1, 2, {2, 2}));
+  EXPECT_EQ(g.argmax(along::rows), grid<size_t>(3, 1, {1, 0, 1}));
+  EXPECT_EQ(grid<double>({nan, nan, nan}).argmin(), 0);
+}
+
+TEST(Grid, ReductionsParallel) {
+  grid<int> g(300, 500);
+  for (size_t i = 0; i < g.storage().size(); ++i)
+    g[i] = static_cast<int>((i * 7919) % 1001) - 500;
+  EXPECT_EQ(g.sum(8), g.sum());
+  EXPECT_EQ(g.minmax(8), g.minmax());
+  EXPECT_EQ(g.argmin(8), g.argmin());
+  EXPECT_EQ(g.argmax(8), g.argmax());
+  EXPECT_NEAR(g.variance(8), g.variance(), 1e-9);
+  EXPECT_EQ(g.sum(along::columns, 8), g.sum(along::columns));
+  EXPECT_EQ(g.sum(along::rows, 8), g.sum(along::rows));
+  EXPECT_EQ(g.minmax(along::rows, 8), g.minmax(along::rows));
+}
+
+TEST(Grid, CastRoundingAndSaturation) {
+  auto gf = grid<float>({-3.5f, -0.5f, 0.5f, 1.5f, 2.7f, 300.0f});
+  EXPECT_EQ(grid_cast<unsigned char>(gf),
+            grid<unsigned char>({0, 0, 0, 2, 3, 255}));
+  EXPECT_EQ(grid_cast<int>(gf),
+            grid<int>({-4, 0, 0, 2, 3, 300}));
+  EXPECT_EQ(grid_cast<int>(gf, rounding::truncate),
+            grid<int>({-3, 0, 0, 1, 2, 300}));
+  EXPECT_EQ(grid_cast<int>(gf, rounding::floor),
+            grid<int>({-4, -1, 0, 1, 2, 300}));
+  EXPECT_EQ(grid_cast<int>(gf, rounding::ceil),
+            grid<int>({-3, 0, 1, 2, 3, 300}));
+  EXPECT_EQ(grid_cast<signed char>(grid<int>({-200, -5, 5, 200})),
+            grid<signed char>({-128, -5, 5, 127}));
+  EXPECT_EQ(grid_cast<unsigned short>(grid<double>({-1e9, 1.5, 1e9})),
+            grid<unsigned short>({0, 2, 65535}));
+}
+
+TEST(Grid, CastKeepsNanAndInfinity) {
+  const float inf = std::numeric_limits<float>::infinity();
+  auto gd = grid_cast<double>(
+      grid<float>({std::nanf(""), inf, -inf}));
+  EXPECT_TRUE(std::isnan(gd(0)));
+  EXPECT_EQ(gd(1), std::numeric_limits<double>::infinity());
+  EXPECT_EQ(gd(2), -std::numeric_limits<double>::infinity());
+  auto gf = grid_cast<float>(grid<double>({1e300, -1e300, 0.5}));
+  EXPECT_EQ(gf, grid<float>({inf, -inf, 0.5f}));
+  EXPECT_EQ(grid_cast<int>(grid<float>({std::nanf(""), inf, -inf})),
+            grid<int>({INT32_MIN, INT32_MAX, INT32_MIN}));
+}
+
+TEST(Grid, CastWideIntegersExactly) {
+  const int64_t big = (int64_t(1) << 60) + 1;
+  auto g64 = grid<int64_t>({big, INT64_MAX, 123456789012345677, INT64_MIN});
+  EXPECT_EQ(grid_cast<int64_t>(g64), g64);
+  EXPECT_EQ(grid_cast<uint64_t>(g64),
+            grid<uint64_t>({uint64_t(big), uint64_t(INT64_MAX),
+                            123456789012345677u, 0}));
+  EXPECT_EQ(grid_cast<int32_t>(g64),
+            grid<int32_t>({INT32_MAX, INT32_MAX, INT32_MAX, INT32_MIN}));
+  auto gu = grid<uint64_t>({UINT64_MAX, uint64_t(big), 5});
+  EXPECT_EQ(grid_cast<int64_t>(gu),
+            grid<int64_t>({INT64_MAX, big, 5}));
+  EXPECT_EQ(grid_cast<uint64_t>(grid<int8_t>({-1, 7, 127})),
+            grid<uint64_t>({0, 7, 127}));
+}
+
+TEST(Grid, CastAffine) {
+  auto gu = grid<unsigned char>(2, 2, {0, 51, 102, 255});
+  auto gf = grid_cast<float>(gu, rounding::nearest, true, 1.0 / 255);
+  EXPECT_EQ(gf.rows(), 2);
+  EXPECT_NEAR(gf(1, 0), 0.2f, 1e-6);
+  EXPECT_NEAR(gf(1, 1), 1.0f, 1e-6);
+  EXPECT_EQ(grid_cast<unsigned char>(gf, rounding::nearest, true, 255), gu);
+  EXPECT_EQ(grid_cast<unsigned char>(gu, rounding::nearest, true, 2, 10),
+            grid<unsigned char>(2, 2, {10, 112, 214, 255}));
+}
+
+TEST(Grid, ConvertIntoReusesStorage) {
+  grid<double> dst(100, 100);
+  const double* before = dst.storage().data();
+  convert_into(grid<int>(10, 10).fill(7), &dst);
+  EXPECT_EQ(dst, grid<double>(10, 10).fill(7));
+  EXPECT_EQ(dst.storage().data(), before);
+}
+
+TEST(Grid, LoadPgmBinary) {
+  const std::string file = ::testing::TempDir() + "grid_test.pgm";
+  auto gu = grid<unsigned char>(3, 2, {0, 1, 127, 128, 200, 255});
+  ASSERT_TRUE(gu.savepgm(file));
+  grid<unsigned char> lu;
+  ASSERT_TRUE(lu.loadpgm(file));
+  EXPECT_EQ(lu, gu);
+  grid<int> li;
+  ASSERT_TRUE(li.loadpgm(file));
+  EXPECT_EQ(li, grid<int>(3, 2, {0, 1, 127, 128, 200, 255}));
+  grid<char> lc;
+  ASSERT_TRUE(lc.loadpgm(file));
+  EXPECT_EQ(lc, grid<char>(3, 2, {0, 1, 127, -128, -56, -1}));
+  ASSERT_TRUE(lc.savepgm(file));
+  ASSERT_TRUE(lu.loadpgm(file));
+  EXPECT_EQ(lu, gu);
+  std::remove(file.c_str());
+}
+
 }  // namespace
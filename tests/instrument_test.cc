@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "grid.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::grid;
+using grid_h::grid_op;
+using grid_h::grid_profile;
+
+static_assert(grid_profile::enabled(), "build with -DGRID_INSTRUMENT");
+
+TEST(Instrument, CountsOperations) {
+  grid_profile::reset();
+  grid<double> a(3, 4), b(4, 2);
+  a.fill(1);
+  b.fill(2);
+  grid<double> c = a * b;
+  c = c.transpose();
+  grid<double> d;
+  a.subgrid(&d, 1, 1, 2, 2);
+
+  const grid_profile p = grid_profile::snapshot();
+  EXPECT_EQ(p[grid_op::multiply].calls, 1);
+  EXPECT_EQ(p[grid_op::multiply].elements, 6);
+  EXPECT_EQ(p[grid_op::multiply].bytes_allocated, 6 * sizeof(double));
+  EXPECT_EQ(p[grid_op::transpose].calls, 1);
+  EXPECT_EQ(p[grid_op::transpose].bytes_copied, 6 * sizeof(double));
+  EXPECT_EQ(p[grid_op::subgrid].elements, 4);
+  EXPECT_EQ(p[grid_op::inverse].calls, 0);
+}
+
+TEST(Instrument, ResetAndIo) {
+  const std::string file = ::testing::TempDir() + "instrument_test.pgm";
+  grid<unsigned char> g(5, 4);
+  g.savepgm(file);
+  grid_profile::reset();
+  EXPECT_EQ(grid_profile::snapshot()[grid_op::savepgm].calls, 0);
+
+  grid<unsigned char> h;
+  h.read(file.c_str());
+  const grid_profile p = grid_profile::snapshot();
+  EXPECT_EQ(p[grid_op::read].calls, 1);
+  EXPECT_EQ(p[grid_op::read].elements, 20);
+  EXPECT_EQ(p[grid_op::loadpgm].calls, 1);
+  std::remove(file.c_str());
+}
+
+TEST(Instrument, MergesThreads) {
+  grid_profile::reset();
+  std::thread worker([]() {
+    grid<double>(2, 2, {2, 0, 0, 4}).inverse();
+  });
+  grid<double>(2, 2, {1, 0, 0, 1}).inverse();
+  worker.join();
+  EXPECT_EQ(grid_profile::snapshot()[grid_op::inverse].calls, 2);
+}
+
+TEST(Instrument, Dump) {
+  grid_profile::reset();
+  grid<int>(2, 3).transpose();
+  const grid_profile p = grid_profile::snapshot();
+
+  std::ostringstream json;
+  p.write_json(json);
+  EXPECT_NE(json.str().find("\"transpose\": {\"calls\": 1, \"elements\": 6"),
+            std::string::npos);
+  EXPECT_EQ(json.str().front(), '{');
+  EXPECT_EQ(json.str().back(), '}');
+
+  std::ostringstream text;
+  p.write_text(text);
+  EXPECT_NE(text.str().find("transpose"), std::string::npos);
+  EXPECT_EQ(text.str().find("inverse"), std::string::npos);
+
+  // The stream's formatting is left as it was.
+  std::ostringstream out;
+  p.write_text(out);
+  out.str("");
+  out << std::setw(4) << 7 << " " << 0.5;
+  EXPECT_EQ(out.str(), "   7 0.5");
+}
+
+}  // namespace
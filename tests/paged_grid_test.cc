@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include "paged_grid.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::grid;
+using grid_h::paged_grid;
+
+class PagedGridTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    file = ::testing::TempDir() + "paged_grid_test.gt";
+  }
+  void TearDown() override { std::remove(file.c_str()); }
+  std::string file;
+};
+
+TEST_F(PagedGridTest, CreateIsZeroFilled) {
+  paged_grid<int> pg;
+  ASSERT_TRUE(pg.create(file, 10, 7, 4, 3));
+  EXPECT_EQ(pg.rows(), 10);
+  EXPECT_EQ(pg.cols(), 7);
+  EXPECT_EQ(pg.get(9, 6), 0);
+  EXPECT_EQ(pg.get(10, 0), 0);
+  EXPECT_EQ(pg.offpixels(), 70);
+}
+
+TEST_F(PagedGridTest, WriteBackAndReopen) {
+  {
+    paged_grid<double> pg(2 * 4 * 3 * sizeof(double));  // Two tiles.
+    ASSERT_TRUE(pg.create(file, 10, 7, 4, 3));
+    for (size_t j = 0; j < 7; ++j)
+      for (size_t i = 0; i < 10; ++i)
+        pg(i, j) = i + 100 * j;
+    EXPECT_GT(pg.evictions(), 0);
+    EXPECT_GT(pg.writebacks(), 0);
+  }
+  paged_grid<double> pg(0);
+  ASSERT_TRUE(pg.open(file));
+  EXPECT_EQ(pg.tile_rows(), 4);
+  EXPECT_EQ(pg.tile_cols(), 3);
+  for (size_t j = 0; j < 7; ++j)
+    for (size_t i = 0; i < 10; ++i)
+      EXPECT_EQ(pg.get(i, j), i + 100 * j);
+}
+
+TEST_F(PagedGridTest, OpenRejectsOtherFiles) {
+  std::ofstream(file) << "P2\n2 2\n255\n0 0 0 0\n";
+  paged_grid<int> pg;
+  EXPECT_FALSE(pg.open(file));
+}
+
+TEST_F(PagedGridTest, TruncatedFile) {
+  {
+    paged_grid<int> pg;
+    ASSERT_TRUE(pg.create(file, 8, 4, 4, 4));
+  }
+  std::ifstream in(file, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)),
+      std::istreambuf_iterator<char>());
+  in.close();
+  contents.resize(contents.size() - 4 * 4 * sizeof(int));  // Lose a tile.
+  std::ofstream(file, std::ios::binary) << contents;
+
+  paged_grid<int> pg;
+  ASSERT_TRUE(pg.open(file));
+  pg(0, 0) = 7;
+  EXPECT_THROW(pg.get(4, 0), std::runtime_error);
+  EXPECT_THROW(pg.get(4, 0), std::runtime_error);
+  EXPECT_EQ(pg.get(0, 0), 7);
+  EXPECT_TRUE(pg.close());
+
+  ASSERT_TRUE(pg.open(file));
+  EXPECT_EQ(pg.get(0, 0), 7);
+  pg.set_readahead(1);
+  EXPECT_EQ(pg.get(0, 0), 7);
+  EXPECT_EQ(pg.misses(), 1);
+  EXPECT_THROW(pg.get(4, 0), std::runtime_error);
+}
+
+TEST_F(PagedGridTest, Counters) {
+  paged_grid<int> pg(2 * 4 * 4 * sizeof(int));
+  ASSERT_TRUE(pg.create(file, 8, 8, 4, 4));
+  pg.get(0, 0);
+  pg.get(1, 1);
+  pg.get(4, 0);
+  pg.get(0, 4);
+  pg.get(0, 0);
+  EXPECT_EQ(pg.misses(), 4);
+  EXPECT_EQ(pg.hits(), 1);
+  EXPECT_EQ(pg.evictions(), 2);
+  EXPECT_EQ(pg.writebacks(), 0);
+  pg.reset_counters();
+  EXPECT_EQ(pg.misses(), 0);
+}
+
+TEST_F(PagedGridTest, ReadsDoNotWriteBack) {
+  paged_grid<int> pg(4 * 4 * sizeof(int));  // One tile.
+  ASSERT_TRUE(pg.create(file, 8, 8, 4, 4));
+  int sum = 0;
+  for (size_t j = 0; j < 8; ++j)
+    for (size_t i = 0; i < 8; ++i)
+      sum += pg(i, j);
+  EXPECT_EQ(sum, 0);
+  EXPECT_EQ(pg.writebacks(), 0);
+
+  auto x = pg(1, 2);
+  x = 5;
+  x += 2;
+  pg(7, 7) = pg(1, 2);
+  EXPECT_EQ(pg.get(1, 2), 7);
+  EXPECT_EQ(pg.get(7, 7), 7);
+  EXPECT_EQ(pg.writebacks(), 2);
+}
+
+TEST_F(PagedGridTest, ReadAhead) {
+  paged_grid<int> pg(4 * 2 * 2 * sizeof(int));
+  ASSERT_TRUE(pg.create(file, 8, 2, 2, 2));
+  pg.set_readahead(3);
+  for (size_t i = 0; i < 8; ++i)
+    pg.get(i, 0);
+  EXPECT_EQ(pg.misses(), 1);
+  EXPECT_EQ(pg.hits(), 7);
+}
+
+TEST_F(PagedGridTest, Reductions) {
+  paged_grid<int> pg(0);
+  ASSERT_TRUE(pg.create(file, 5, 5, 2, 2));
+  pg(0, 0) = -3;
+  pg(4, 4) = 8;
+  pg(2, 3) = 1;
+  EXPECT_EQ(pg.onpixels(), 3);
+  EXPECT_EQ(pg.minmax(), std::make_pair(-3, 8));
+
+  pg.modify_tiles([](size_t, size_t, grid<int>& t) { t += 1; });
+  EXPECT_EQ(pg.get(1, 1), 1);
+  EXPECT_EQ(pg.minmax(), std::make_pair(-2, 9));
+
+  size_t ntiles = 0;
+  pg.for_each_tile([&ntiles](size_t r, size_t c, const grid<int>& t) {
+    EXPECT_EQ(t.rows(), 2);
+    EXPECT_EQ(r % 2 + c % 2, 0);
+    ++ntiles;
+  });
+  EXPECT_EQ(ntiles, 9);
+}
+
+}  // namespace
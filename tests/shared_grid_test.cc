@@ -0,0 +1,70 @@
+#include <thread>
+#include <vector>
+
+#include "shared_grid.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::grid;
+using grid_h::shared_grid;
+
+TEST(SharedGrid, ConstructorEmpty) {
+  shared_grid<int> s;
+  EXPECT_EQ(s.rows(), 0);
+  EXPECT_EQ(s.cols(), 0);
+  EXPECT_EQ(s.use_count(), 1);
+}
+
+TEST(SharedGrid, CopiesShareStorage) {
+  shared_grid<int> s(grid<int>(2, 2, {1, 2, 3, 4}));
+  shared_grid<int> t = s;
+  EXPECT_EQ(s.use_count(), 2);
+  EXPECT_EQ(&s.view(), &t.view());
+  EXPECT_EQ(t(1, 0), 2);
+}
+
+TEST(SharedGrid, CopyOnWrite) {
+  shared_grid<int> s(grid<int>(2, 2, {1, 2, 3, 4}));
+  shared_grid<int> t = s;
+  t(0, 1) = 9;
+  EXPECT_EQ(s.use_count(), 1);
+  EXPECT_EQ(t.use_count(), 1);
+  EXPECT_EQ(s.view(), grid<int>(2, 2, {1, 2, 3, 4}));
+  EXPECT_EQ(t.view(), grid<int>(2, 2, {1, 2, 9, 4}));
+
+  // A unique handle is written in place.
+  const grid<int>* before = &t.view();
+  t.edit().fill(5);
+  EXPECT_EQ(&t.view(), before);
+}
+
+TEST(SharedGrid, TakeGrid) {
+  grid<int> g(2, 2, {1, 2, 3, 4});
+  shared_grid<int> s;
+  s << g;
+  EXPECT_EQ(g.rows(), 0);
+  EXPECT_EQ(s.view(), grid<int>(2, 2, {1, 2, 3, 4}));
+}
+
+TEST(SharedGrid, FanOutToThreads) {
+  shared_grid<int> s(grid<int>(100, 100).fill(1));
+  std::vector<int> sums(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([s, t, &sums]() mutable {
+      if (t % 2) {
+        s.edit() += t;
+      }
+      for (auto el : s)
+        sums[t] += el;
+    });
+  }
+  for (auto& th : threads)
+    th.join();
+  EXPECT_EQ(sums, std::vector<int>({10000, 20000, 10000, 40000}));
+  EXPECT_EQ(s.view(), grid<int>(100, 100).fill(1));
+  EXPECT_EQ(s.use_count(), 1);
+}
+
+}  // namespace
@@ -0,0 +1,97 @@
+#include "sparse_grid.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using grid_h::grid;
+using grid_h::sparse_grid;
+
+// A 4x4 symmetric positive definite tridiagonal grid.
+sparse_grid<double> Laplacian() {
+  return sparse_grid<double>(4, 4,
+      {0, 1, 0, 1, 2, 1, 2, 3, 2, 3},
+      {0, 0, 1, 1, 1, 2, 2, 2, 3, 3},
+      {2, -1, -1, 2, -1, -1, 2, -1, -1, 2});
+}
+
+TEST(SparseGrid, ConstructorEmpty) {
+  sparse_grid<double> s(3, 4);
+  EXPECT_EQ(s.rows(), 3);
+  EXPECT_EQ(s.cols(), 4);
+  EXPECT_EQ(s.nonzeros(), 0);
+  EXPECT_EQ(s.dense(), grid<double>(3, 4).clear());
+}
+
+TEST(SparseGrid, ConstructorTriplets) {
+  // Unordered triplets with a duplicate at (1, 0).
+  sparse_grid<int> s(2, 3, {1, 0, 1, 1}, {2, 1, 0, 0}, {5, 3, 1, 2});
+  EXPECT_EQ(s.nonzeros(), 3);
+  EXPECT_EQ(s.colptrs(), std::vector<size_t>({0, 1, 2, 3}));
+  EXPECT_EQ(s.dense(), grid<int>(2, 3, {0, 3, 3, 0, 0, 5}));
+  EXPECT_EQ(s(1, 0), 3);
+  EXPECT_EQ(s(0, 0), 0);
+}
+
+TEST(SparseGrid, ConstructorDense) {
+  grid<double> g(2, 2, {1, 0.01, 0, -4});
+  EXPECT_EQ(sparse_grid<double>(g).nonzeros(), 3);
+  sparse_grid<double> s(g, 0.1);
+  EXPECT_EQ(s.nonzeros(), 2);
+  EXPECT_EQ(s.dense(), grid<double>(2, 2, {1, 0, 0, -4}));
+
+  grid<unsigned> gu(2, 2, {3, 0, 1, 7});
+  EXPECT_EQ(sparse_grid<unsigned>(gu).nonzeros(), 3);
+  EXPECT_EQ(sparse_grid<unsigned>(gu, 2).dense(),
+            grid<unsigned>(2, 2, {3, 0, 0, 7}));
+}
+
+TEST(SparseGrid, Transpose) {
+  grid<int> g(3, 2, {1, 0, 2, 0, 3, 4});
+  EXPECT_EQ(sparse_grid<int>(g).transpose().dense(), g.transpose());
+  EXPECT_EQ(sparse_grid<int>(g).transpose().transpose(), sparse_grid<int>(g));
+}
+
+TEST(SparseGrid, Multiply) {
+  grid<int> g(3, 2, {1, 0, 2, 0, 3, 4});
+  grid<int> m(2, 3, {1, 2, 3, 4, 5, 6});
+  EXPECT_EQ(sparse_grid<int>(g) * m, g * m);
+  grid<int> x(2, 1, {7, 8});
+  EXPECT_EQ(sparse_grid<int>(g) * x, g * x);
+}
+
+TEST(SparseGrid, MultiplyThreaded) {
+  const size_t n = 50;
+  grid<double> g(n, n), x(n), m(n, 7);
+  for (size_t i = 0; i < n * n; ++i)
+    g[i] = (i % 7 == 0) ? static_cast<double>(i % 13) : 0;
+  for (size_t i = 0; i < n; ++i)
+    x(i) = i;
+  for (size_t i = 0; i < n * 7; ++i)
+    m[i] = i % 5;
+  sparse_grid<double> s(g);
+  EXPECT_EQ(s.multiply(x, 4), g * x);
+  EXPECT_EQ(s.multiply(m, 3), g * m);
+  EXPECT_EQ(s.multiply(m, 0), g * m);
+}
+
+TEST(SparseGrid, ConjugateGradient) {
+  grid<double> b({1, 0, 0, 1});
+  size_t iters = 0;
+  grid<double> x = Laplacian().cg(b, 1e-12, 0, &iters);
+  EXPECT_LE(iters, 4);
+  for (size_t i = 0; i < 4; ++i)
+    EXPECT_NEAR(x(i), 1.0, 1e-9);
+  EXPECT_EQ(Laplacian().cg(b, 1e-12, 0, nullptr, 4), x);
+}
+
+TEST(SparseGrid, BiCGSTAB) {
+  grid<double> g(3, 3, {4, 1, 0, 2, 5, 1, 0, 3, 6});
+  grid<double> b({1, 2, 3});
+  grid<double> x = sparse_grid<double>(g).bicgstab(b, 1e-12, 50);
+  grid<double> r = g * x - b;
+  for (size_t i = 0; i < 3; ++i)
+    EXPECT_NEAR(r(i), 0.0, 1e-9);
+  EXPECT_EQ(sparse_grid<double>(g).bicgstab(b, 1e-12, 50, nullptr, 3), x);
+}
+
+}  // namespace
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "utils.h"
 #include "gtest/gtest.h"
 
@@ -7,6 +9,7 @@ using utils_h::distance;
 using utils_h::distance_squared;
 using utils_h::linfdist;
 using utils_h::angle;
+using utils_h::parallel_for;
 
 TEST(Utils, Distance) {
   EXPECT_EQ(5.0, distance(0, 0, 3, 4));
@@ -32,4 +35,18 @@ TEST(Utils, Angle) {
   EXPECT_NEAR(-0.927, angle(0, 0, 3, 4), 0.001);
 }
 
+TEST(Utils, ParallelFor) {
+  std::vector<int> v(1000);
+  parallel_for(v.size(), 4, [&v](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      v[i] += i;
+  });
+  for (size_t i = 0; i < v.size(); ++i)
+    EXPECT_EQ(v[i], i);
+
+  int calls = 0;
+  parallel_for(0, 4, [&calls](size_t, size_t) { ++calls; });
+  EXPECT_EQ(calls, 0);
+}
+
 }  // namespace
@@ -6,6 +6,8 @@
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 namespace utils_h {
 
@@ -30,9 +32,9 @@ namespace utils_h {
 #endif
 
 #define arraywrite(s, v, n) \
-{ for (int aw_i = 0; aw_i < n; ++aw_i) varwrite(s, (v[aw_i])) }
+{ for (size_t aw_i = 0; aw_i < n; ++aw_i) varwrite(s, (v[aw_i])) }
 #define arrayread(s, v, n) \
-{ for (int ar_i = 0; ar_i < n; ++ar_i) varread(s, (v[ar_i])) }
+{ for (size_t ar_i = 0; ar_i < n; ++ar_i) varread(s, (v[ar_i])) }
 
 // __________________________________________________________________________
 
@@ -61,6 +63,34 @@ inline double angle(const T x1, const T y1, const T x2, const T y2) {
   return atan2(y1 - y2, x2 - x1);
 }
 
+// __________________________________________________________________________
+// Resolve a requested thread count; 0 means one thread per core.
+
+inline size_t num_threads(size_t nthreads) {
+  return nthreads > 0 ? nthreads :
+      std::max(1u, std::thread::hardware_concurrency());
+}
+
+// __________________________________________________________________________
+// Split [0, n) into at most 'nthreads' contiguous ranges of nearly equal
+// size and call f(begin, end) for each range on its own thread.
+
+template <class F>
+void parallel_for(size_t n, size_t nthreads, F f) {
+  nthreads = std::min(num_threads(nthreads), n);
+  if (nthreads <= 1) {
+    if (n > 0)
+      f(0, n);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < nthreads; ++t)
+    threads.emplace_back(f, n * t / nthreads, n * (t + 1) / nthreads);
+  f(0, n / nthreads);
+  for (auto& th : threads)
+    th.join();
+}
+
 };  // namespace utils_h
 
 #endif  // UTILS_H_